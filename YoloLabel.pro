@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui widgets
+QT       += core gui widgets concurrent
 
 TARGET = YoloLabel
 TEMPLATE = app
@@ -25,15 +25,60 @@ CONFIG += c++1z
 SOURCES += \
         main.cpp \
         mainwindow.cpp \
-    label_img.cpp
+    label_img.cpp \
+    autolabel_worker.cpp \
+    image_prefetcher.cpp \
+    image_cache.cpp \
+    image_pyramid.cpp \
+    gamma_lut.cpp \
+    image_dir_index.cpp \
+    dataset_manifest.cpp \
+    image_list.cpp \
+    yolo_label_io.cpp \
+    label_writer.cpp \
+    edit_journal.cpp \
+    annotation_store.cpp \
+    label_exporter.cpp \
+    autolabel_batch.cpp
 
 HEADERS += \
         mainwindow.h \
-    label_img.h
+    label_img.h \
+    autolabel_worker.h \
+    image_prefetcher.h \
+    image_cache.h \
+    image_pyramid.h \
+    decoded_image.h \
+    gamma_lut.h \
+    image_dir_index.h \
+    dataset_manifest.h \
+    image_list.h \
+    yolo_label_io.h \
+    label_writer.h \
+    edit_journal.h \
+    annotation_store.h \
+    label_exporter.h \
+    autolabel_batch.h
 
 FORMS += \
         mainwindow.ui
 
+# In-process ONNX Runtime autolabel backend (CPU). Without it autolabel falls
+# back to running models/autolabel.py through python.
+#   qmake "CONFIG+=onnx" ONNXRUNTIME_DIR=/opt/homebrew/opt/onnxruntime
+onnx {
+    isEmpty(ONNXRUNTIME_DIR): ONNXRUNTIME_DIR = $$(ONNXRUNTIME_DIR)
+    isEmpty(ONNXRUNTIME_DIR): error("CONFIG+=onnx needs ONNXRUNTIME_DIR (onnxruntime install prefix)")
+
+    DEFINES += ONNX_INFERENCE
+    SOURCES += yolo_onnx.cpp yolo_preprocess.cpp yolo_decode.cpp yolo_nms.cpp autolabel_lookahead.cpp
+    HEADERS += yolo_onnx.h yolo_preprocess.h yolo_decode.h yolo_nms.h autolabel_lookahead.h
+
+    INCLUDEPATH += $$ONNXRUNTIME_DIR/include $$ONNXRUNTIME_DIR/include/onnxruntime
+    LIBS += -L$$ONNXRUNTIME_DIR/lib -lonnxruntime
+    unix: QMAKE_RPATHDIR += $$ONNXRUNTIME_DIR/lib
+}
+
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
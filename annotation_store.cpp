@@ -0,0 +1,474 @@
+#include "annotation_store.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <algorithm>
+
+static const quint32 kStoreMagic   = 0x594C4C42;   // "YLLB"
+static const quint32 kStoreVersion = 1;
+static const quint32 kIndexMagic   = 0x594C4958;   // "YLIX"
+static const qint64  kHeaderBytes  = 8;
+static const qint64  kRecordBytes  = 12;           // type, 0, u16 key, u32 size, u16 crc, 0
+static const qint64  kTrailerBytes = 16;           // i64 index offset, magic, version
+
+enum RecordType : quint8 { Put = 1, Delete = 2, Index = 3 };
+
+static quint16 checksumOf(const char *key, int keyLen, const char *data, quint32 size)
+{
+    QByteArray body;
+    body.reserve(keyLen + int(size));
+    body.append(key, keyLen);
+    body.append(data, int(size));
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    return qChecksum(body);
+#else
+    return qChecksum(body.constData(), uint(body.size()));
+#endif
+}
+
+AnnotationStore::~AnnotationStore()
+{
+    close();
+}
+
+QString AnnotationStore::pathFor(const QString &dir)
+{
+    return QDir(dir).filePath(".yololabel.labels");
+}
+
+bool AnnotationStore::exists(const QString &dir)
+{
+    return QFileInfo::exists(pathFor(dir));
+}
+
+QByteArray AnnotationStore::keyFor(const QString &labelPath)
+{
+    return QFileInfo(labelPath).fileName().toUtf8();
+}
+
+bool AnnotationStore::open(const QString &dir, const QString &labelDir)
+{
+    close();
+
+    QMutexLocker lock(&m_mutex);
+    m_file.setFileName(pathFor(dir));
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        qWarning() << "[store] cannot open" << m_file.fileName() << ":" << m_file.errorString();
+        return false;
+    }
+
+    uchar header[kHeaderBytes];
+    if (m_file.size() == 0) {
+        qToLittleEndian(kStoreMagic, header);
+        qToLittleEndian(kStoreVersion, header + 4);
+        m_file.write(reinterpret_cast<const char *>(header), kHeaderBytes);
+        m_file.flush();
+        m_end = kHeaderBytes;
+    } else if (m_file.read(reinterpret_cast<char *>(header), kHeaderBytes) != kHeaderBytes ||
+               qFromLittleEndian<quint32>(header) != kStoreMagic ||
+               qFromLittleEndian<quint32>(header + 4) != kStoreVersion) {
+        qWarning() << "[store] not a label store (or a newer one):" << m_file.fileName();
+        m_file.close();
+        return false;
+    } else {
+        m_map = m_file.map(0, m_file.size());
+        m_mapSize = m_map ? m_file.size() : 0;
+        if (!m_map) {
+            qWarning() << "[store] cannot map" << m_file.fileName() << ":" << m_file.errorString();
+            m_file.close();
+            return false;
+        }
+        if (!loadIndex())
+            scanRecords();
+        // The index (or a torn record) is overwritten by the next append;
+        // anything past m_end gets mapped afresh once it's written
+        m_file.resize(m_end);
+        m_mapSize = std::min(m_mapSize, m_end);
+    }
+
+    m_labelDir = labelDir;
+    qDebug() << "[store] opened" << m_file.fileName() << "with" << m_index.size() << "label files";
+    return true;
+}
+
+void AnnotationStore::close()
+{
+    QMutexLocker lock(&m_mutex);
+    if (!m_file.isOpen())
+        return;
+
+    // Compact once most of the file is replaced records
+    if (!(m_deadBytes > m_liveBytes && m_deadBytes > (1 << 20) && rewriteLive()))
+        writeIndex();
+
+    if (m_map)
+        m_file.unmap(m_map);
+    m_map = nullptr;
+    m_mapSize = 0;
+    m_file.close();
+    m_index.clear();
+    m_end = m_liveBytes = m_deadBytes = 0;
+}
+
+bool AnnotationStore::isOpen() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_file.isOpen();
+}
+
+qint64 AnnotationStore::textSize(const QString &labelPath) const
+{
+    QMutexLocker lock(&m_mutex);
+    auto it = m_index.constFind(keyFor(labelPath));
+    return it == m_index.constEnd() ? -1 : qint64(it->size);
+}
+
+bool AnnotationStore::read(const QString &labelPath, QVector<YoloLabel> &out) const
+{
+    QMutexLocker lock(&m_mutex);
+    auto it = m_index.constFind(keyFor(labelPath));
+    if (it == m_index.constEnd())
+        return false;
+    if (it->size == 0)
+        return true;
+
+    const char *text = mapped(*it);
+    if (!text)
+        return false;
+    QVector<YoloLabelError> errors;
+    parseYoloLabels(text, it->size, out, &errors);
+    for (const YoloLabelError &e : std::as_const(errors))
+        qWarning().noquote() << QString("[store] %1:%2: %3, line skipped")
+                                    .arg(labelPath).arg(e.line).arg(e.reason);
+    return true;
+}
+
+bool AnnotationStore::write(const QString &labelPath, const QByteArray &text)
+{
+    QMutexLocker lock(&m_mutex);
+    if (!m_file.isOpen())
+        return false;
+    const bool ok = append(Put, keyFor(labelPath), text.constData(), quint32(text.size()));
+    return m_file.flush() && ok;
+}
+
+bool AnnotationStore::remove(const QString &labelPath)
+{
+    QMutexLocker lock(&m_mutex);
+    const QByteArray key = keyFor(labelPath);
+    if (!m_file.isOpen() || !m_index.contains(key))
+        return false;
+    const bool ok = append(Delete, key, nullptr, 0);
+    return m_file.flush() && ok;
+}
+
+bool AnnotationStore::adoptFile(const QString &labelPath)
+{
+    QFile f(labelPath);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray text = f.readAll();
+    f.close();
+    if (!write(labelPath, text))
+        return false;
+    QFile::remove(labelPath);
+    return true;
+}
+
+int AnnotationStore::importText(const std::atomic_bool *cancel)
+{
+    if (!isOpen() || m_labelDir.isEmpty())
+        return -1;
+
+    const QStringList names = QDir(m_labelDir).entryList({"*.txt"}, QDir::Files);
+    const QString labelDir = m_labelDir;
+    auto readText = [labelDir](const QString &name) {
+        QFile f(QDir(labelDir).filePath(name));
+        return f.open(QIODevice::ReadOnly) ? f.readAll() : QByteArray();
+    };
+
+    // Reads overlap (they're what's slow on network filesystems), appends don't
+    const int kChunk = 1024;
+    int done = 0;
+    for (int first = 0; first < names.size(); first += kChunk) {
+        if (cancel && cancel->load())
+            break;
+        const QStringList chunk = names.mid(first, kChunk);
+        const QList<QByteArray> texts = QtConcurrent::blockingMapped<QList<QByteArray>>(chunk, readText);
+
+        QMutexLocker lock(&m_mutex);
+        for (int i = 0; i < chunk.size(); ++i)
+            if (append(Put, chunk[i].toUtf8(), texts[i].constData(), quint32(texts[i].size())))
+                ++done;
+        m_file.flush();
+    }
+    qDebug() << "[store] imported" << done << "label files from" << labelDir;
+    return done;
+}
+
+int AnnotationStore::exportText(const std::atomic_bool *cancel) const
+{
+    QVector<QPair<QString, QByteArray>> files;
+    {
+        QMutexLocker lock(&m_mutex);
+        if (!m_file.isOpen() || m_labelDir.isEmpty())
+            return -1;
+        files.reserve(m_index.size());
+        for (auto it = m_index.cbegin(); it != m_index.cend(); ++it) {
+            const char *text = it->size ? mapped(*it) : "";
+            if (text)
+                files.push_back(qMakePair(QString::fromUtf8(it.key()), QByteArray(text, int(it->size))));
+        }
+    }
+
+    QDir().mkpath(m_labelDir);
+    const QString labelDir = m_labelDir;
+    std::atomic_int written{0};
+    QtConcurrent::blockingMap(files, [&](const QPair<QString, QByteArray> &file) {
+        if (cancel && cancel->load())
+            return;
+        QFile f(QDir(labelDir).filePath(file.first));
+        if (f.open(QIODevice::WriteOnly | QIODevice::Truncate) && f.write(file.second) == file.second.size())
+            ++written;
+        else
+            qWarning() << "[store] cannot export" << f.fileName() << ":" << f.errorString();
+    });
+    qDebug() << "[store] exported" << written.load() << "label files to" << labelDir;
+    return written.load();
+}
+
+// Record: type, 0, u16 key length, u32 text size, u16 CRC of key + text, 0,
+// then the key and the text. Caller holds m_mutex and flushes.
+bool AnnotationStore::append(quint8 type, const QByteArray &key, const char *data, quint32 size)
+{
+    uchar head[kRecordBytes] = {};
+    head[0] = type;
+    qToLittleEndian(quint16(key.size()), head + 2);
+    qToLittleEndian(size, head + 4);
+    qToLittleEndian(checksumOf(key.constData(), key.size(), data, size), head + 8);
+
+    if (!m_file.seek(m_end) ||
+        m_file.write(reinterpret_cast<const char *>(head), kRecordBytes) != kRecordBytes ||
+        m_file.write(key) != key.size() ||
+        (size && m_file.write(data, size) != qint64(size))) {
+        qWarning() << "[store] write failed:" << m_file.errorString();
+        return false;
+    }
+
+    const qint64 recordBytes = kRecordBytes + key.size() + size;
+    auto old = m_index.constFind(key);
+    if (old != m_index.constEnd()) {
+        const qint64 oldBytes = kRecordBytes + key.size() + old->size;
+        m_liveBytes -= oldBytes;
+        m_deadBytes += oldBytes;
+    }
+    if (type == Put) {
+        m_index.insert(key, Entry{m_end + kRecordBytes + key.size(), size});
+        m_liveBytes += recordBytes;
+    } else {
+        m_index.remove(key);
+        m_deadBytes += recordBytes;
+    }
+    m_end += recordBytes;
+    return true;
+}
+
+// Index record (key-less): u32 count, then per entry u16 key length, key,
+// i64 text offset, u32 text size. The trailer after it points back at it.
+bool AnnotationStore::loadIndex()
+{
+    const qint64 size = m_mapSize;
+    if (size < kHeaderBytes + kRecordBytes + kTrailerBytes)
+        return false;
+    const uchar *p = m_map;
+    const uchar *trailer = p + size - kTrailerBytes;
+    if (qFromLittleEndian<quint32>(trailer + 8) != kIndexMagic ||
+        qFromLittleEndian<quint32>(trailer + 12) != kStoreVersion)
+        return false;
+
+    const qint64 at = qFromLittleEndian<qint64>(trailer);
+    if (at < kHeaderBytes || at + kRecordBytes > size - kTrailerBytes || p[at] != Index)
+        return false;
+    const quint32 len = qFromLittleEndian<quint32>(p + at + 4);
+    if (at + kRecordBytes + qint64(len) != size - kTrailerBytes)
+        return false;
+    const char *body = reinterpret_cast<const char *>(p + at + kRecordBytes);
+    if (qFromLittleEndian<quint16>(p + at + 8) != checksumOf(nullptr, 0, body, len))
+        return false;
+
+    const uchar *q = p + at + kRecordBytes;
+    const uchar *const end = q + len;
+    if (end - q < 4)
+        return false;
+    const quint32 count = qFromLittleEndian<quint32>(q);
+    q += 4;
+
+    QHash<QByteArray, Entry> index;
+    index.reserve(int(std::min<quint32>(count, 1u << 24)));
+    qint64 live = 0;
+    for (quint32 i = 0; i < count; ++i) {
+        if (end - q < 2) return false;
+        const quint16 keyLen = qFromLittleEndian<quint16>(q);
+        if (end - q < 2 + keyLen + 12) return false;
+        const QByteArray key(reinterpret_cast<const char *>(q + 2), keyLen);
+        q += 2 + keyLen;
+        const Entry e{qFromLittleEndian<qint64>(q), qFromLittleEndian<quint32>(q + 8)};
+        q += 12;
+        if (e.offset < kHeaderBytes || e.offset + qint64(e.size) > at)
+            return false;
+        index.insert(key, e);
+        live += kRecordBytes + keyLen + e.size;
+    }
+
+    m_index = std::move(index);
+    m_end = at;
+    m_liveBytes = live;
+    m_deadBytes = at - kHeaderBytes - live;
+    return true;
+}
+
+void AnnotationStore::scanRecords()
+{
+    m_index.clear();
+    m_liveBytes = m_deadBytes = 0;
+
+    const uchar *p = m_map;
+    qint64 pos = kHeaderBytes;
+    while (pos + kRecordBytes <= m_mapSize) {
+        const quint8  type   = p[pos];
+        const quint16 keyLen = qFromLittleEndian<quint16>(p + pos + 2);
+        const quint32 size   = qFromLittleEndian<quint32>(p + pos + 4);
+        const qint64  next   = pos + kRecordBytes + keyLen + size;
+        if (type < Put || type > Index || next > m_mapSize)
+            break;   // torn tail
+        const char *key  = reinterpret_cast<const char *>(p + pos + kRecordBytes);
+        const char *data = key + keyLen;
+        if (qFromLittleEndian<quint16>(p + pos + 8) != checksumOf(key, keyLen, data, size))
+            break;
+
+        const QByteArray k(key, keyLen);
+        auto old = m_index.constFind(k);
+        if (old != m_index.constEnd()) {
+            m_liveBytes -= kRecordBytes + keyLen + old->size;
+            m_deadBytes += kRecordBytes + keyLen + old->size;
+        }
+        if (type == Put) {
+            m_index.insert(k, Entry{pos + kRecordBytes + keyLen, size});
+            m_liveBytes += next - pos;
+        } else {
+            m_index.remove(k);
+            m_deadBytes += next - pos;   // deletes and stale indexes
+        }
+        pos = next;
+    }
+    m_end = pos;
+    if (pos != m_mapSize)
+        qWarning() << "[store] recovered" << m_file.fileName() << "up to byte" << pos;
+}
+
+bool AnnotationStore::writeIndex()
+{
+    QByteArray body;
+    body.reserve(4 + m_index.size() * 32);
+    uchar buf[12];
+    qToLittleEndian(quint32(m_index.size()), buf);
+    body.append(reinterpret_cast<const char *>(buf), 4);
+    for (auto it = m_index.cbegin(); it != m_index.cend(); ++it) {
+        qToLittleEndian(quint16(it.key().size()), buf);
+        body.append(reinterpret_cast<const char *>(buf), 2);
+        body += it.key();
+        qToLittleEndian(qint64(it->offset), buf);
+        qToLittleEndian(it->size, buf + 8);
+        body.append(reinterpret_cast<const char *>(buf), 12);
+    }
+
+    const qint64 at = m_end;
+    if (!append(Index, QByteArray(), body.constData(), quint32(body.size())))
+        return false;
+
+    uchar trailer[kTrailerBytes];
+    qToLittleEndian(qint64(at), trailer);
+    qToLittleEndian(kIndexMagic, trailer + 8);
+    qToLittleEndian(kStoreVersion, trailer + 12);
+    m_file.write(reinterpret_cast<const char *>(trailer), kTrailerBytes);
+    return m_file.flush() && m_file.resize(m_end + kTrailerBytes);
+}
+
+// Copies the live records into a fresh file (plus index) and swaps it in.
+bool AnnotationStore::rewriteLive()
+{
+    QSaveFile out(m_file.fileName());
+    if (!out.open(QIODevice::WriteOnly))
+        return false;
+
+    uchar header[kHeaderBytes];
+    qToLittleEndian(kStoreMagic, header);
+    qToLittleEndian(kStoreVersion, header + 4);
+    out.write(reinterpret_cast<const char *>(header), kHeaderBytes);
+
+    // Same record layout as append(), but into `out`
+    QHash<QByteArray, Entry> index;
+    index.reserve(m_index.size());
+    qint64 pos = kHeaderBytes;
+    for (auto it = m_index.cbegin(); it != m_index.cend(); ++it) {
+        const char *text = it->size ? mapped(*it) : "";
+        if (!text) {
+            out.cancelWriting();
+            return false;
+        }
+        uchar head[kRecordBytes] = {};
+        head[0] = Put;
+        qToLittleEndian(quint16(it.key().size()), head + 2);
+        qToLittleEndian(it->size, head + 4);
+        qToLittleEndian(checksumOf(it.key().constData(), it.key().size(), text, it->size), head + 8);
+        out.write(reinterpret_cast<const char *>(head), kRecordBytes);
+        out.write(it.key());
+        out.write(text, it->size);
+        index.insert(it.key(), Entry{pos + kRecordBytes + it.key().size(), it->size});
+        pos += kRecordBytes + it.key().size() + it->size;
+    }
+
+    // Index + trailer go through the normal path once the new file is in place
+    if (m_map)
+        m_file.unmap(m_map);
+    m_map = nullptr;
+    m_mapSize = 0;
+    m_file.close();
+    if (!out.commit()) {
+        qWarning() << "[store] compaction failed:" << out.errorString();
+        m_file.open(QIODevice::ReadWrite);
+        return false;
+    }
+
+    if (!m_file.open(QIODevice::ReadWrite))
+        return false;
+    m_index = std::move(index);
+    m_end = pos;
+    m_liveBytes = pos - kHeaderBytes;
+    m_deadBytes = 0;
+    writeIndex();
+    return true;
+}
+
+const char *AnnotationStore::mapped(const Entry &e) const
+{
+    if (e.offset + qint64(e.size) > m_mapSize) {
+        // Appended since the last map
+        m_file.flush();
+        if (m_map)
+            m_file.unmap(m_map);
+        m_mapSize = m_file.size();
+        m_map = m_file.map(0, m_mapSize);
+        if (!m_map) {
+            m_mapSize = 0;
+            qWarning() << "[store] cannot map" << m_file.fileName() << ":" << m_file.errorString();
+            return nullptr;
+        }
+    }
+    return reinterpret_cast<const char *>(m_map) + e.offset;
+}
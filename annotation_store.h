@@ -0,0 +1,80 @@
+#ifndef ANNOTATION_STORE_H
+#define ANNOTATION_STORE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include "yolo_label_io.h"
+
+#include <atomic>
+
+// All of a dataset's labels in one file, "<dir>/.yololabel.labels", as an
+// alternative to one .txt per image. Each label file is kept as its exact
+// text, so importing from and exporting to the .txt layout is lossless, and
+// reads parse straight out of the memory-mapped file.
+//
+// Writes append a record; the newest record for a name wins. An index of
+// name -> record is written at the end on close() and read back on open(),
+// so opening doesn't touch the records. Without one (crash) the records are
+// scanned instead. Space taken by replaced records is reclaimed on close()
+// once it outweighs the live data. Thread-safe.
+class AnnotationStore
+{
+public:
+    AnnotationStore() = default;
+    ~AnnotationStore();
+
+    static QString pathFor(const QString &dir);
+    static bool exists(const QString &dir);
+
+    // `labelDir` is where the .txt files live, for import/export.
+    bool open(const QString &dir, const QString &labelDir);
+    void close();
+    bool isOpen() const;
+
+    // Label files are named by their path; only the file name is the key.
+    qint64 textSize(const QString &labelPath) const;   // -1 if absent
+    bool   read(const QString &labelPath, QVector<YoloLabel> &out) const;
+    bool   write(const QString &labelPath, const QByteArray &text);
+    bool   remove(const QString &labelPath);
+
+    // Moves a .txt written by someone else (autolabel) into the store.
+    bool adoptFile(const QString &labelPath);
+
+    // Whole-dataset conversion from/to the .txt files in labelDir. Both
+    // return the number of label files handled, -1 on error.
+    int importText(const std::atomic_bool *cancel = nullptr);
+    int exportText(const std::atomic_bool *cancel = nullptr) const;
+
+private:
+    struct Entry {
+        qint64  offset;   // of the text
+        quint32 size;
+    };
+
+    static QByteArray keyFor(const QString &labelPath);
+
+    bool append(quint8 type, const QByteArray &key, const char *data, quint32 size);
+    bool loadIndex();
+    void scanRecords();
+    bool writeIndex();
+    bool rewriteLive();
+    const char *mapped(const Entry &e) const;   // caller holds m_mutex
+
+    mutable QMutex m_mutex;
+    mutable QFile  m_file;
+    mutable uchar *m_map = nullptr;
+    mutable qint64 m_mapSize = 0;
+
+    QString m_labelDir;
+    QHash<QByteArray, Entry> m_index;
+    qint64 m_end = 0;        // where the next record goes
+    qint64 m_liveBytes = 0;
+    qint64 m_deadBytes = 0;
+};
+
+#endif // ANNOTATION_STORE_H
@@ -0,0 +1,262 @@
+#include "autolabel_batch.h"
+#include "annotation_store.h"
+#include "autolabel_worker.h"
+#include "label_img.h"
+#include "label_writer.h"
+#ifdef ONNX_INFERENCE
+#include "yolo_onnx.h"
+#endif
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <algorithm>
+
+// Decode size for inference: twice the 640 model input is plenty, and JPEGs
+// decode that much smaller natively (see label_img::decodeImage)
+static const int kDecodeEdge = 1280;
+
+// autolabel.py handles one request at a time; one more queued behind it
+// keeps it from idling between replies
+static const int kWorkerInFlight = 2;
+
+static const qint64 kReportMsecs = 250;
+
+AutolabelBatch::AutolabelBatch(LabelWriter *writer, AutolabelWorker *worker, QObject *parent)
+    : QObject(parent), m_writer(writer), m_worker(worker)
+{
+    connect(m_worker, &AutolabelWorker::labeled, this, &AutolabelBatch::onWorkerLabeled);
+}
+
+AutolabelBatch::~AutolabelBatch()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+#ifdef ONNX_INFERENCE
+void AutolabelBatch::setModel(const std::shared_ptr<YoloOnnx> &model, int threads)
+{
+    m_model = model;
+    // Each Run() already spreads over ORT's intra-op threads; a couple of
+    // images at once overlaps one image's decode with another's inference
+    m_pool.setMaxThreadCount(std::max(1, threads));
+}
+#endif
+
+int AutolabelBatch::start(const QString &imageDir, const ImageList &images, const QString &labelDir)
+{
+    if (m_running)
+        return -1;
+
+    m_imageDir = imageDir;
+    m_labelDir = labelDir;
+    m_images   = images;
+    m_queue.clear();
+    for (int i = 0; i < m_images.size(); ++i)
+        if (m_images.meta(i).boxes <= 0)
+            m_queue.push_back(i);
+    if (m_queue.isEmpty())
+        return 0;
+
+    m_next = 0;
+    m_inFlight = 0;
+    m_submitted.clear();
+    ++m_generation;
+    m_cancel = std::make_shared<std::atomic_bool>(false);
+#ifdef ONNX_INFERENCE
+    m_maxInFlight = m_model ? m_pool.maxThreadCount() : kWorkerInFlight;
+#else
+    m_maxInFlight = kWorkerInFlight;
+#endif
+
+    m_running = true;
+    m_paused  = false;
+    m_progress = Progress();
+    m_progress.total = m_queue.size();
+    m_activeMsecs = 0;
+    m_clock.start();
+    m_lastReport.start();
+
+    qDebug() << "[autolabel] batch:" << m_queue.size() << "of" << m_images.size() << "images to label";
+    report(true);
+    pump();
+    return m_progress.total;
+}
+
+void AutolabelBatch::pause()
+{
+    if (!m_running || m_paused)
+        return;
+    m_paused = true;
+    m_activeMsecs += m_clock.elapsed();
+    report(true);
+}
+
+void AutolabelBatch::resume()
+{
+    if (!m_running || !m_paused)
+        return;
+    m_paused = false;
+    m_clock.start();
+    report(true);
+    pump();
+}
+
+void AutolabelBatch::cancel()
+{
+    if (!m_running)
+        return;
+    m_cancel->store(true);
+    ++m_generation;
+    m_inFlight = 0;
+    m_submitted.clear();
+    finish(true);
+}
+
+bool AutolabelBatch::hasLabels(const QString &labelPath) const
+{
+    QVector<YoloLabel> queued;
+    if (m_writer->pending(labelPath, queued))
+        return true;
+    if (m_store && m_store->isOpen())
+        return m_store->textSize(labelPath) > 0;
+    const QFileInfo li(labelPath);
+    return li.isFile() && li.size() > 0;
+}
+
+void AutolabelBatch::pump()
+{
+    while (m_running && !m_paused && m_inFlight < m_maxInFlight && m_next < m_queue.size()) {
+        const QString name = m_images.name(m_queue.at(m_next++));
+        launch(m_imageDir + '/' + name,
+               QDir(m_labelDir).filePath(QFileInfo(name).completeBaseName() + ".txt"));
+    }
+    if (m_running && m_inFlight == 0 && m_next >= m_queue.size())
+        finish(false);
+}
+
+void AutolabelBatch::launch(const QString &imagePath, const QString &labelPath)
+{
+#ifdef ONNX_INFERENCE
+    if (m_model) {
+        ++m_inFlight;
+        const quint64 generation = m_generation;
+        const auto cancel = m_cancel;
+        const std::shared_ptr<YoloOnnx> model = m_model;
+        m_pool.start([this, generation, cancel, model, imagePath, labelPath]() {
+            Outcome outcome = Failed;
+            QVector<YoloLabel> labels;
+            if (cancel->load())
+                return;
+            if (hasLabels(labelPath)) {
+                outcome = Skipped;
+            } else {
+                const DecodedImage img = label_img::decodeImage(imagePath, QSize(kDecodeEdge, kDecodeEdge));
+                if (!img.isNull() && !cancel->load()) {
+                    labels  = detectionsToLabels(model->infer(img.image));
+                    outcome = Detected;
+                }
+            }
+            QMetaObject::invokeMethod(this, [=]() {
+                onResult(generation, imagePath, labelPath, outcome, labels);
+            }, Qt::QueuedConnection);
+        });
+        return;
+    }
+#endif
+
+    // autolabel.py checks the .txt again before writing, but not the store
+    if (hasLabels(labelPath) || m_worker->isPending(imagePath)) {
+        count(Skipped, 0);
+        return;
+    }
+    if (m_worker->submit(imagePath, labelPath) < 0) {
+        qWarning() << "[autolabel] batch: the autolabel worker could not be started";
+        count(Failed, 0);
+        m_next = m_queue.size();   // every other image would fail the same way
+        return;
+    }
+    m_submitted.insert(imagePath);
+    ++m_inFlight;
+}
+
+void AutolabelBatch::onResult(quint64 generation, const QString &imagePath, const QString &labelPath,
+                              Outcome outcome, const QVector<YoloLabel> &labels)
+{
+    if (generation != m_generation)
+        return;   // cancelled
+    --m_inFlight;
+
+    // Labeled (or deleted) while the model ran: the user's version wins
+    if (outcome == Detected && !labels.isEmpty() && (hasLabels(labelPath) || !QFileInfo::exists(imagePath)))
+        outcome = Skipped;
+    if (outcome == Detected && !labels.isEmpty()) {
+        m_writer->save(labelPath, labels);
+        emit labeled(imagePath, labelPath, true, labels);
+    }
+
+    count(outcome, outcome == Detected ? labels.size() : 0);
+    report();
+    pump();
+}
+
+void AutolabelBatch::onWorkerLabeled(const QString &imagePath, const QString &, bool ok,
+                                     const QVector<YoloLabel> &labels)
+{
+    // Requests of the per-image autolabel come through here as well
+    if (!m_submitted.remove(imagePath))
+        return;
+    --m_inFlight;
+    count(ok ? Detected : Failed, labels.size());
+    report();
+    pump();
+}
+
+void AutolabelBatch::count(Outcome outcome, int boxes)
+{
+    ++m_progress.done;
+    switch (outcome) {
+    case Detected:
+        if (boxes > 0) {
+            ++m_progress.labeled;
+            m_progress.boxes += boxes;
+        }
+        break;
+    case Skipped:
+        ++m_progress.skipped;
+        break;
+    case Failed:
+        ++m_progress.failed;
+        break;
+    }
+}
+
+void AutolabelBatch::report(bool force)
+{
+    m_progress.msecs = m_activeMsecs + (m_running && !m_paused ? m_clock.elapsed() : 0);
+    if (!force && m_lastReport.elapsed() < kReportMsecs)
+        return;
+    m_lastReport.start();
+    emit progressChanged(m_progress);
+}
+
+void AutolabelBatch::finish(bool cancelled)
+{
+    if (!m_paused)
+        m_activeMsecs += m_clock.elapsed();
+    m_running = false;
+    m_paused  = false;
+    m_progress.msecs = m_activeMsecs;
+    m_queue.clear();
+    m_images.clear();
+
+    qDebug().noquote() << QString("[autolabel] batch %1: %2 / %3 images, %4 labeled (%5 boxes), %6 skipped, %7 failed in %8 s, %9 images/s")
+                              .arg(cancelled ? "cancelled" : "done")
+                              .arg(m_progress.done).arg(m_progress.total)
+                              .arg(m_progress.labeled).arg(m_progress.boxes)
+                              .arg(m_progress.skipped).arg(m_progress.failed)
+                              .arg(m_progress.msecs / 1000.0, 0, 'f', 1)
+                              .arg(m_progress.imagesPerSec(), 0, 'f', 1);
+    emit finished(m_progress, cancelled);
+}
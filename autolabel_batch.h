@@ -0,0 +1,121 @@
+#ifndef AUTOLABEL_BATCH_H
+#define AUTOLABEL_BATCH_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+
+#include "image_list.h"
+#include "yolo_label_io.h"
+
+#include <atomic>
+#include <memory>
+
+class AnnotationStore;
+class AutolabelWorker;
+class LabelWriter;
+class YoloOnnx;
+
+// "Autolabel all": runs the model over every image of a dataset that has no
+// labels yet, in the background, while the user keeps labeling. With the
+// in-process model, images are decoded and inferred on a small thread pool
+// and the results saved through the LabelWriter; otherwise requests go to
+// the autolabel.py worker, which writes the files itself. Only a few images
+// are in flight at a time, so pause() and cancel() take effect right away
+// and a 100k-image job doesn't queue 100k tasks.
+//
+// Whether an image still has no labels is checked again right before it is
+// labeled and before its result is saved: if the user (or the per-image
+// autolabel in goto_img) got there first, it is skipped.
+class AutolabelBatch : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Progress {
+        int    total = 0;
+        int    done = 0;         // everything below, plus images with no detections
+        int    labeled = 0;      // saved with at least one box
+        int    skipped = 0;      // had labels by the time we got to them
+        int    failed = 0;
+        qint64 boxes = 0;
+        qint64 msecs = 0;        // running time, pauses left out
+        double imagesPerSec() const { return msecs > 0 ? done * 1000.0 / msecs : 0; }
+        qint64 etaMsecs() const { return done > 0 ? qint64(double(msecs) / done * (total - done)) : -1; }
+    };
+
+    AutolabelBatch(LabelWriter *writer, AutolabelWorker *worker, QObject *parent = nullptr);
+    ~AutolabelBatch();   // cancels, waits for the pool
+
+    // Labels are looked up in `store` while it is open, in .txt files otherwise
+    void setStore(const AnnotationStore *store) { m_store = store; }
+#ifdef ONNX_INFERENCE
+    // In-process model, shared with the window; null falls back to the worker
+    void setModel(const std::shared_ptr<YoloOnnx> &model, int threads);
+#endif
+
+    // Queues the images without labels (ImageMeta::boxes <= 0). Returns how
+    // many, -1 if a job is already running.
+    int  start(const QString &imageDir, const ImageList &images, const QString &labelDir);
+    void pause();
+    void resume();
+    void cancel();   // images in flight finish, their results are dropped
+
+    bool isRunning() const { return m_running; }
+    bool isPaused() const { return m_paused; }
+    const Progress &progress() const { return m_progress; }
+
+signals:
+    // Same shape as AutolabelWorker::labeled(), for results saved here
+    void labeled(const QString &imagePath, const QString &labelPath, bool ok,
+                 const QVector<YoloLabel> &labels);
+    void progressChanged(const AutolabelBatch::Progress &progress);
+    void finished(const AutolabelBatch::Progress &progress, bool cancelled);
+
+private slots:
+    void onWorkerLabeled(const QString &imagePath, const QString &labelPath, bool ok,
+                         const QVector<YoloLabel> &labels);
+
+private:
+    enum Outcome { Detected, Skipped, Failed };
+
+    bool hasLabels(const QString &labelPath) const;   // any thread
+    void pump();
+    void launch(const QString &imagePath, const QString &labelPath);
+    void onResult(quint64 generation, const QString &imagePath, const QString &labelPath,
+                  Outcome outcome, const QVector<YoloLabel> &labels);
+    void count(Outcome outcome, int boxes);
+    void report(bool force = false);
+    void finish(bool cancelled);
+
+    LabelWriter     *m_writer;
+    AutolabelWorker *m_worker;
+    const AnnotationStore *m_store = nullptr;
+#ifdef ONNX_INFERENCE
+    std::shared_ptr<YoloOnnx> m_model;
+#endif
+    QThreadPool m_pool;
+
+    QString      m_imageDir;
+    QString      m_labelDir;
+    ImageList    m_images;           // snapshot taken at start()
+    QVector<int> m_queue;            // indices into m_images
+    int          m_next = 0;
+    int          m_inFlight = 0;
+    int          m_maxInFlight = 1;
+    QSet<QString> m_submitted;       // images sent to the worker
+    quint64      m_generation = 0;   // results of an earlier job are dropped
+    std::shared_ptr<std::atomic_bool> m_cancel;
+
+    bool          m_running = false;
+    bool          m_paused = false;
+    Progress      m_progress;
+    qint64        m_activeMsecs = 0; // before the current run of m_clock
+    QElapsedTimer m_clock;           // running since start/resume
+    QElapsedTimer m_lastReport;
+};
+
+#endif // AUTOLABEL_BATCH_H
@@ -0,0 +1,113 @@
+#include "autolabel_lookahead.h"
+#include "image_dir_index.h"
+#include "label_img.h"
+#include "yolo_onnx.h"
+
+#include <QSet>
+#include <QtConcurrent>
+
+AutolabelLookahead::AutolabelLookahead(ImageCache *cache, QObject *parent)
+    : QObject(parent), m_cache(cache)
+{
+    // One image at a time: each Run() already uses ORT's intra-op threads,
+    // and the nearest image should be done first
+    m_pool.setMaxThreadCount(1);
+    m_decodeSize = label_img::displayDecodeSize();
+}
+
+AutolabelLookahead::~AutolabelLookahead()
+{
+    clear();
+    m_pool.waitForDone();
+}
+
+void AutolabelLookahead::setModel(const std::shared_ptr<YoloOnnx> &model)
+{
+    if (model == m_model)
+        return;
+    clear();
+    m_model = model;
+}
+
+void AutolabelLookahead::predictAround(const ImageDirIndex &list, int index, int direction)
+{
+    if (!m_model || index < 0 || index >= list.size())
+        return;
+
+    const int step = direction < 0 ? -1 : +1;
+    QStringList wanted;
+    for (int i = 1; i <= m_ahead; ++i) {
+        const int k = index + i * step;
+        if (k < 0 || k >= list.size())
+            break;
+        if (list.meta(k).boxes <= 0)
+            wanted << list.at(k);
+    }
+
+    // Keep the current image's result too, goto_img may not have taken it yet
+    QSet<QString> keep(wanted.begin(), wanted.end());
+    keep.insert(list.at(index));
+    for (auto it = m_jobs.begin(); it != m_jobs.end(); ) {
+        if (!keep.contains(it.key())) {
+            it->cancelled->store(true);
+            it = m_jobs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Nearest first
+    for (const QString &path : std::as_const(wanted))
+        if (!m_jobs.contains(path))
+            schedule(path);
+}
+
+void AutolabelLookahead::schedule(const QString &path)
+{
+    Job job;
+    job.cancelled = std::make_shared<std::atomic_bool>(false);
+    auto cancelled = job.cancelled;
+    ImageCache *cache = m_cache;
+    const std::shared_ptr<YoloOnnx> model = m_model;
+    const QSize decodeSize = m_decodeSize;
+    job.future = QtConcurrent::run(&m_pool, [path, cancelled, cache, model, decodeSize]() {
+        Result r;
+        if (cancelled->load())
+            return r;
+        // Stamp before decoding so a rewrite during the decode reads as stale
+        r.stamp = ImageCache::stampOf(path);
+        DecodedImage img;
+        if (!cache->lookup(path, img)) {
+            img = label_img::decodeImage(path, decodeSize);
+            cache->insert(path, img, r.stamp);
+        }
+        if (img.isNull() || cancelled->load())
+            return r;
+        r.labels = detectionsToLabels(model->infer(img.image));
+        r.ok = true;
+        return r;
+    });
+    m_jobs.insert(path, job);
+}
+
+bool AutolabelLookahead::take(const QString &path, QVector<YoloLabel> &labels)
+{
+    auto it = m_jobs.find(path);
+    if (it == m_jobs.end())
+        return false;
+    const Job job = *it;
+    m_jobs.erase(it);
+
+    const Result r = job.future.result();   // blocks if still running
+    if (!r.ok || r.stamp != ImageCache::stampOf(path))
+        return false;
+    labels = r.labels;
+    return true;
+}
+
+void AutolabelLookahead::clear()
+{
+    for (const Job &job : std::as_const(m_jobs))
+        job.cancelled->store(true);
+    m_jobs.clear();
+}
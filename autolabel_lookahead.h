@@ -0,0 +1,71 @@
+#ifndef AUTOLABEL_LOOKAHEAD_H
+#define AUTOLABEL_LOOKAHEAD_H
+
+#include <QFuture>
+#include <QHash>
+#include <QObject>
+#include <QSize>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+
+#include "image_cache.h"
+#include "yolo_label_io.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+class ImageDirIndex;
+class YoloOnnx;
+
+// Runs the in-process model a few images ahead of the cursor, in the
+// direction of travel, so goto_img can show autolabel boxes without waiting
+// for inference. Only images without labels (ImageMeta::boxes <= 0) are
+// predicted. Results wait in memory until the user arrives or they fall out
+// of the window; queued jobs outside the window (a long slider jump) are
+// cancelled. Images are taken from, or decoded into, the shared ImageCache,
+// so a predicted image is also a prefetched one.
+class AutolabelLookahead : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AutolabelLookahead(ImageCache *cache, QObject *parent = nullptr);
+    ~AutolabelLookahead();
+
+    // A different model drops everything predicted with the old one
+    void setModel(const std::shared_ptr<YoloOnnx> &model);
+    void setWindow(int ahead) { m_ahead = std::max(0, ahead); }
+
+    // Schedules the next images after `index` and forgets what's outside.
+    void predictAround(const ImageDirIndex &list, int index, int direction);
+
+    // Detections for `path`, ready or in flight (waits for it). False if it
+    // wasn't predicted, or the image changed since.
+    bool take(const QString &path, QVector<YoloLabel> &labels);
+
+    void clear();
+
+private:
+    struct Result {
+        QVector<YoloLabel> labels;
+        ImageCache::Stamp  stamp;
+        bool ok = false;
+    };
+    struct Job {
+        QFuture<Result> future;
+        std::shared_ptr<std::atomic_bool> cancelled;
+    };
+
+    void schedule(const QString &path);
+
+    ImageCache *m_cache;
+    std::shared_ptr<YoloOnnx> m_model;
+    QThreadPool m_pool;
+    QHash<QString, Job> m_jobs;   // finished ones too, until taken or evicted
+    QSize m_decodeSize;           // same as the prefetcher, so the cache entry is reused
+    int   m_ahead = 3;
+};
+
+#endif // AUTOLABEL_LOOKAHEAD_H
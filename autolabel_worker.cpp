@@ -0,0 +1,178 @@
+#include "autolabel_worker.h"
+
+#include <QDebug>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcessEnvironment>
+#include <utility>
+
+AutolabelWorker::AutolabelWorker(QObject *parent)
+    : QObject(parent)
+{
+    connect(&m_proc, &QProcess::readyReadStandardOutput, this, &AutolabelWorker::onReadyReadStandardOutput);
+    connect(&m_proc, &QProcess::readyReadStandardError,  this, &AutolabelWorker::onReadyReadStandardError);
+    connect(&m_proc, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &AutolabelWorker::onFinished);
+}
+
+AutolabelWorker::~AutolabelWorker()
+{
+    // Nobody is left to receive replies; just let the process go.
+    m_proc.disconnect(this);
+    m_pending.clear();
+    stop();
+}
+
+void AutolabelWorker::configure(const QString &python, const QString &script,
+                                const QString &namesPath, const QString &modelPath)
+{
+    if (python == m_python && script == m_script &&
+        namesPath == m_namesPath && modelPath == m_modelPath)
+        return;
+
+    stop();
+    m_python    = python;
+    m_script    = script;
+    m_namesPath = namesPath;
+    m_modelPath = modelPath;
+}
+
+bool AutolabelWorker::ensureStarted()
+{
+    if (isRunning())
+        return true;
+    if (m_script.isEmpty() || m_namesPath.isEmpty())
+        return false;
+
+    QStringList args;
+    args << m_script << "--serve" << m_namesPath;
+    if (!m_modelPath.isEmpty())
+        args << m_modelPath;
+
+    // Environment: make Spotlight launches work (PATH) + model env var (belt & braces)
+    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+    QString path = env.value("PATH");
+    if (path.isEmpty()) path = "/usr/bin:/bin:/usr/sbin:/sbin";
+    if (!path.contains("/opt/homebrew/bin"))
+        path += ":/opt/homebrew/bin:/usr/local/bin";
+    env.insert("PATH", path);
+    env.insert("PYTHONUNBUFFERED", "1");
+    if (!m_modelPath.isEmpty())
+        env.insert("YOLO_MODEL_PATH", m_modelPath);
+    m_proc.setProcessEnvironment(env);
+
+    // Run from script dir so relative paths inside autolabel.py work
+    m_proc.setWorkingDirectory(QFileInfo(m_script).absolutePath());
+
+    m_stdoutBuf.clear();
+    m_proc.start(m_python, args);
+    if (!m_proc.waitForStarted(5000)) {
+        qDebug() << "[autolabel] failed to start" << m_python << ":" << m_proc.errorString();
+        return false;
+    }
+    qDebug() << "[autolabel] worker started, pid" << m_proc.processId();
+    return true;
+}
+
+void AutolabelWorker::stop()
+{
+    if (!isRunning())
+        return;
+
+    m_proc.closeWriteChannel();   // EOF on stdin ends the serve loop
+    if (!m_proc.waitForFinished(2000)) {
+        m_proc.kill();
+        m_proc.waitForFinished(1000);
+    }
+    failPending();
+}
+
+int AutolabelWorker::submit(const QString &imagePath, const QString &labelPath)
+{
+    if (!ensureStarted())
+        return -1;
+
+    const int id = m_nextId++;
+    m_pending.insert(id, Request{imagePath, labelPath});
+
+    QJsonObject req;
+    req.insert("id", id);
+    req.insert("image", imagePath);
+    req.insert("label", labelPath);
+    m_proc.write(QJsonDocument(req).toJson(QJsonDocument::Compact) + '\n');
+    return id;
+}
+
+bool AutolabelWorker::isPending(const QString &imagePath) const
+{
+    for (const Request &r : m_pending)
+        if (r.imagePath == imagePath) return true;
+    return false;
+}
+
+void AutolabelWorker::onReadyReadStandardOutput()
+{
+    m_stdoutBuf += m_proc.readAllStandardOutput();
+
+    int nl;
+    while ((nl = m_stdoutBuf.indexOf('\n')) >= 0) {
+        const QByteArray line = m_stdoutBuf.left(nl).trimmed();
+        m_stdoutBuf.remove(0, nl + 1);
+        if (!line.startsWith('{')) {
+            if (!line.isEmpty()) qDebug() << "[autolabel][stdout]" << line;
+            continue;
+        }
+
+        const QJsonObject reply = QJsonDocument::fromJson(line).object();
+        const int id = reply.value("id").toInt(-1);
+        if (!m_pending.contains(id))
+            continue;
+
+        const Request req = m_pending.take(id);
+        const bool ok = reply.value("ok").toBool();
+        if (!ok)
+            qDebug() << "[autolabel] failed" << req.imagePath << ":" << reply.value("error").toString();
+
+        // [[cls, cx, cy, w, h, conf], ...], normalized like the label file
+        QVector<YoloLabel> labels;
+        const QJsonArray boxes = reply.value("boxes").toArray();
+        labels.reserve(boxes.size());
+        for (const QJsonValue &v : boxes) {
+            const QJsonArray b = v.toArray();
+            if (b.size() < 5)
+                continue;
+            YoloLabel l;
+            l.cls  = b.at(0).toInt();
+            l.cx   = b.at(1).toDouble();
+            l.cy   = b.at(2).toDouble();
+            l.w    = b.at(3).toDouble();
+            l.h    = b.at(4).toDouble();
+            l.conf = b.size() > 5 ? b.at(5).toDouble() : 1.0;
+            labels.push_back(l);
+        }
+        emit labeled(req.imagePath, req.labelPath, ok, labels);
+    }
+}
+
+void AutolabelWorker::onReadyReadStandardError()
+{
+    const QByteArray err = m_proc.readAllStandardError();
+    if (!err.isEmpty())
+        qDebug() << "[autolabel][stderr]" << err;
+}
+
+void AutolabelWorker::onFinished(int exitCode, QProcess::ExitStatus status)
+{
+    qDebug() << "[autolabel] worker exited, code" << exitCode
+             << (status == QProcess::CrashExit ? "(crashed)" : "");
+    failPending();
+}
+
+void AutolabelWorker::failPending()
+{
+    const QHash<int, Request> pending = std::exchange(m_pending, {});
+    for (const Request &r : pending)
+        emit labeled(r.imagePath, r.labelPath, false, {});
+}
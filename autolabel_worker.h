@@ -0,0 +1,63 @@
+#ifndef AUTOLABEL_WORKER_H
+#define AUTOLABEL_WORKER_H
+
+#include <QObject>
+#include <QProcess>
+#include <QHash>
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+
+#include "yolo_label_io.h"
+
+// Long-lived "autolabel.py --serve" process. The model is loaded once per
+// session; requests go out as JSON lines on stdin and replies come back
+// asynchronously through labeled(), boxes and scores included, so the result
+// doesn't have to be read back from the label file the script also writes.
+class AutolabelWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AutolabelWorker(QObject *parent = nullptr);
+    ~AutolabelWorker();
+
+    // Restarts the process only if one of the settings changed.
+    void configure(const QString &python, const QString &script,
+                   const QString &namesPath, const QString &modelPath);
+
+    int  submit(const QString &imagePath, const QString &labelPath);
+    bool isPending(const QString &imagePath) const;
+    bool isRunning() const { return m_proc.state() != QProcess::NotRunning; }
+
+signals:
+    void labeled(const QString &imagePath, const QString &labelPath, bool ok,
+                 const QVector<YoloLabel> &labels);
+
+private slots:
+    void onReadyReadStandardOutput();
+    void onReadyReadStandardError();
+    void onFinished(int exitCode, QProcess::ExitStatus status);
+
+private:
+    struct Request {
+        QString imagePath;
+        QString labelPath;
+    };
+
+    bool ensureStarted();
+    void stop();
+    void failPending();
+
+    QProcess m_proc;
+    QByteArray m_stdoutBuf;
+    QHash<int, Request> m_pending;
+    int m_nextId = 1;
+
+    QString m_python;
+    QString m_script;
+    QString m_namesPath;
+    QString m_modelPath;
+};
+
+#endif // AUTOLABEL_WORKER_H
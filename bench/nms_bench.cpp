@@ -0,0 +1,54 @@
+// NMS microbenchmark, driven by nms_bench.py, which compares the result and
+// the timing with per_class_nms() in models/autolabel.py.
+//
+//   nms_bench <candidates.f32> <iou> [--agnostic]
+//
+// The candidates file is float32 rows of x1 y1 x2 y2 score cls. Prints one
+// JSON line: the kept indices in output order and the median time.
+
+#include "yolo_nms.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static const int kRuns = 50;
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        std::fprintf(stderr, "usage: nms_bench <candidates.f32> <iou> [--agnostic]\n");
+        return 2;
+    }
+    const float iou = float(std::atof(argv[2]));
+    const bool agnostic = argc > 3 && std::strcmp(argv[3], "--agnostic") == 0;
+
+    FILE *f = std::fopen(argv[1], "rb");
+    if (!f) {
+        std::perror(argv[1]);
+        return 1;
+    }
+    std::vector<NmsBox> boxes;
+    float row[6];
+    while (std::fread(row, sizeof(float), 6, f) == 6)
+        boxes.push_back({row[0], row[1], row[2], row[3], row[4], int(row[5])});
+    std::fclose(f);
+
+    std::vector<int> keep;
+    std::vector<double> ms;
+    for (int i = 0; i < kRuns; ++i) {
+        const auto t0 = std::chrono::steady_clock::now();
+        keep = yoloNms(boxes, iou, agnostic);
+        ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+    }
+    std::nth_element(ms.begin(), ms.begin() + kRuns / 2, ms.end());
+
+    std::printf("{\"ms\": %.4f, \"keep\": [", ms[kRuns / 2]);
+    for (size_t i = 0; i < keep.size(); ++i)
+        std::printf(i ? ", %d" : "%d", keep[i]);
+    std::printf("]}\n");
+    return 0;
+}
@@ -0,0 +1,16 @@
+# NMS microbenchmark, run through nms_bench.py
+CONFIG   += console c++1z
+CONFIG   -= app_bundle qt
+
+TARGET = nms_bench
+TEMPLATE = app
+DESTDIR = $$PWD
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    nms_bench.cpp \
+    ../yolo_nms.cpp
+
+HEADERS += \
+    ../yolo_nms.h
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+# Compares yoloNms() (C++, bench/nms_bench) with per_class_nms() in
+# models/autolabel.py: same boxes kept, and how long each takes.
+#
+#   cd bench && qmake nms_bench.pro && make
+#   python3 nms_bench.py [--model model.onnx] [--names ../Samples/obj_names.txt]
+#
+# Candidate sets are the pre-NMS boxes of the Samples/ images (needs a model,
+# found like autolabel.py finds it) plus synthetic crowded frames with
+# thousands of overlapping boxes.
+import argparse, json, subprocess, sys, tempfile, time
+from pathlib import Path
+
+import numpy as np
+
+BENCH_DIR = Path(__file__).resolve().parent
+ROOT = BENCH_DIR.parent
+sys.path.insert(0, str(ROOT / "models"))
+import autolabel  # noqa: E402
+
+
+def sample_sets(model, names):
+    try:
+        session = autolabel.load_session(autolabel.resolve_model_path(model))
+    except (FileNotFoundError, OSError) as e:
+        print(f"[nms_bench] no model, Samples/ skipped: {e}")
+        return
+    for img in sorted((ROOT / "Samples").rglob("*")):
+        if img.suffix.lower() not in (".jpg", ".jpeg", ".png"):
+            continue
+        res = autolabel.candidates(session, str(img), names)
+        if res is not None:
+            xyxy, sc, cl, _, _ = res
+            yield img.name, xyxy, sc, cl
+
+
+def crowded_sets(names, rng):
+    for n, objects in ((500, 40), (3000, 150), (8000, 300)):
+        centres = rng.uniform([0, 0], [4000, 3000], size=(objects, 2))
+        c = centres[rng.integers(0, objects, n)] + rng.normal(0, 15, size=(n, 2))
+        wh = rng.uniform(20, 300, size=(n, 2))
+        xyxy = np.concatenate([c - wh / 2, c + wh / 2], axis=1).clip(0, None).astype(np.float32)
+        sc = rng.uniform(autolabel.conf_thres, 1, n).astype(np.float32)
+        cl = rng.integers(0, min(len(names), 3), n)
+        yield f"crowded {n}", xyxy, sc, cl
+
+
+def python_nms(xyxy, sc, cl, names, runs):
+    times = []
+    for _ in range(runs):
+        t0 = time.perf_counter()
+        final = autolabel.per_class_nms(xyxy, sc, cl, names)
+        times.append((time.perf_counter() - t0) * 1000)
+    return final, float(np.median(times))
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--model")
+    ap.add_argument("--names", default=str(ROOT / "Samples" / "obj_names.txt"))
+    ap.add_argument("--runs", type=int, default=5)
+    args = ap.parse_args()
+
+    exe = BENCH_DIR / "nms_bench"
+    if not exe.exists():
+        sys.exit("build bench/nms_bench first (qmake nms_bench.pro && make)")
+    names = autolabel.load_names(args.names)
+    rng = np.random.default_rng(0)
+
+    sets = list(sample_sets(args.model, names)) + list(crowded_sets(names, rng))
+    for name, xyxy, sc, cl in sets:
+        final, py_ms = python_nms(xyxy, sc, cl, names, args.runs)
+
+        with tempfile.NamedTemporaryFile(suffix=".f32") as f:
+            rows = np.column_stack([xyxy, sc, cl]).astype(np.float32)
+            f.write(rows.tobytes())
+            f.flush()
+            out = subprocess.run([str(exe), f.name, str(autolabel.iou_thres)],
+                                 check=True, capture_output=True, text=True).stdout
+        reply = json.loads(out)
+        cpp = [(int(cl[i]), xyxy[i], float(sc[i])) for i in reply["keep"]]
+
+        same = len(cpp) == len(final) and all(
+            a[0] == b[0] and np.allclose(a[1], b[1]) and abs(a[2] - b[2]) < 1e-6
+            for a, b in zip(cpp, final))
+        print(f"{name}: {len(sc)} candidates, kept python {len(final)} / C++ {len(cpp)}, "
+              f"{'same' if same else 'DIFFERENT'}; python {py_ms:.3f} ms, C++ {reply['ms']:.3f} ms "
+              f"({py_ms / max(reply['ms'], 1e-6):.0f}x)")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,115 @@
+// Preprocessing microbenchmark: the fused letterboxChw() against the
+// QImage::scaled + per-pixel copy it replaced in YoloOnnx::infer().
+//
+//   cd bench && qmake preprocess_bench.pro && make && ./preprocess_bench [images...]
+//
+// Without arguments the Samples/ images are used. Reports the median time
+// per image for both, and how far apart their outputs are (the old path
+// used Qt's smooth scaling, the new one cv2-style bilinear like autolabel.py).
+
+#include "yolo_preprocess.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+static const int kInput = 640;
+static const int kRuns  = 50;
+
+static void before(const QImage &image, std::vector<float> &input)
+{
+    const QImage rgb = image.convertToFormat(QImage::Format_RGB888);
+    const int W = rgb.width(), H = rgb.height();
+    const double r = std::min(kInput / double(W), kInput / double(H));
+    const int nw = std::max(1, int(std::round(W * r)));
+    const int nh = std::max(1, int(std::round(H * r)));
+    const int left = (kInput - nw) / 2;
+    const int top  = (kInput - nh) / 2;
+
+    const QImage resized = rgb.scaled(nw, nh, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+                              .convertToFormat(QImage::Format_RGB888);
+
+    const size_t plane = size_t(kInput) * kInput;
+    input.assign(plane * 3, 114.0f / 255.0f);
+    for (int y = 0; y < nh; ++y) {
+        const uchar *src = resized.constScanLine(y);
+        const size_t row = size_t(top + y) * kInput + left;
+        for (int x = 0; x < nw; ++x) {
+            input[0 * plane + row + x] = src[x * 3 + 0] / 255.0f;
+            input[1 * plane + row + x] = src[x * 3 + 1] / 255.0f;
+            input[2 * plane + row + x] = src[x * 3 + 2] / 255.0f;
+        }
+    }
+}
+
+template <typename F>
+static double medianMsecs(F &&f)
+{
+    std::vector<qint64> ns;
+    ns.reserve(kRuns);
+    for (int i = 0; i < kRuns; ++i) {
+        QElapsedTimer t;
+        t.start();
+        f();
+        ns.push_back(t.nsecsElapsed());
+    }
+    std::nth_element(ns.begin(), ns.begin() + kRuns / 2, ns.end());
+    return ns[kRuns / 2] / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    QStringList paths = app.arguments().mid(1);
+    if (paths.isEmpty()) {
+        const QDir samples(QCoreApplication::applicationDirPath() + "/../Samples");
+        for (const QFileInfo &fi : samples.entryInfoList({"*.jpg", "*.png"}, QDir::Files))
+            paths << fi.filePath();
+        for (const QFileInfo &fi : QDir(samples.filePath("images")).entryInfoList({"*.jpg", "*.png"}, QDir::Files))
+            paths << fi.filePath();
+    }
+    if (paths.isEmpty()) {
+        out << "usage: preprocess_bench [images...]\n";
+        return 1;
+    }
+
+    std::vector<float> a, b(size_t(kInput) * kInput * 3);
+    double totalBefore = 0, totalAfter = 0;
+    for (const QString &path : std::as_const(paths)) {
+        QImageReader reader(path);
+        reader.setAutoTransform(true);
+        const QImage image = reader.read().convertToFormat(QImage::Format_RGB888);
+        if (image.isNull()) {
+            out << path << ": cannot read\n";
+            continue;
+        }
+
+        const double msBefore = medianMsecs([&]() { before(image, a); });
+        const double msAfter  = medianMsecs([&]() { letterboxChw(image, kInput, kInput, b.data()); });
+        totalBefore += msBefore;
+        totalAfter  += msAfter;
+
+        double maxDiff = 0, sumDiff = 0;
+        for (size_t i = 0; i < b.size(); ++i) {
+            const double d = std::fabs(double(a[i]) - b[i]);
+            maxDiff = std::max(maxDiff, d);
+            sumDiff += d;
+        }
+        out << QString("%1 (%2x%3): before %4 ms, fused %5 ms (%6x); diff max %7, mean %8 (of 255)\n")
+                   .arg(QFileInfo(path).fileName()).arg(image.width()).arg(image.height())
+                   .arg(msBefore, 0, 'f', 2).arg(msAfter, 0, 'f', 2)
+                   .arg(msBefore / std::max(1e-6, msAfter), 0, 'f', 1)
+                   .arg(maxDiff * 255, 0, 'f', 1).arg(sumDiff / b.size() * 255, 0, 'f', 2);
+    }
+    out << QString("total: before %1 ms, fused %2 ms\n").arg(totalBefore, 0, 'f', 2).arg(totalAfter, 0, 'f', 2);
+    return 0;
+}
@@ -0,0 +1,17 @@
+# Preprocessing microbenchmark, see preprocess_bench.cpp
+QT       += core gui
+CONFIG   += console c++1z
+CONFIG   -= app_bundle
+
+TARGET = preprocess_bench
+TEMPLATE = app
+DESTDIR = $$PWD
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    preprocess_bench.cpp \
+    ../yolo_preprocess.cpp
+
+HEADERS += \
+    ../yolo_preprocess.h
@@ -0,0 +1,141 @@
+#include "dataset_manifest.h"
+#include "image_dir_index.h"
+#include "yolo_label_io.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QSaveFile>
+
+static const quint32 kManifestMagic   = 0x594C4D46;   // "YLMF"
+static const quint32 kManifestVersion = 2;
+
+QString DatasetManifest::pathFor(const QString &dir)
+{
+    return QDir(dir).filePath(".yololabel.manifest");
+}
+
+bool DatasetManifest::load(const QString &dir, ImageList &list)
+{
+    QFile f(pathFor(dir));
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&f);
+    in.setVersion(QDataStream::Qt_5_12);
+
+    quint32 magic = 0, version = 0;
+    qint64 count = -1;
+    in >> magic >> version;
+    if (magic != kManifestMagic || version != kManifestVersion)
+        return false;
+    in >> count;
+    if (count < 0 || count > (qint64(1) << 28))
+        return false;
+
+    ImageList loaded;
+    QByteArray name;
+    for (qint64 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        ImageMeta m;
+        in >> name >> m.mtime >> m.size >> m.width >> m.height >> m.boxes >> m.labelMtime;
+        loaded.append(QString::fromUtf8(name), m);
+    }
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "[manifest] truncated or corrupt:" << f.fileName();
+        return false;
+    }
+    loaded.sort();   // written in order, so just a check
+
+    list = std::move(loaded);
+    return true;
+}
+
+bool DatasetManifest::save(const QString &dir, const ImageList &list)
+{
+    QSaveFile f(pathFor(dir));
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&f);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << kManifestMagic << kManifestVersion << qint64(list.size());
+    for (int i = 0; i < list.size(); ++i) {
+        const ImageMeta &m = list.meta(i);
+        out << list.nameUtf8(i) << m.mtime << m.size << m.width << m.height << m.boxes << m.labelMtime;
+    }
+
+    if (out.status() != QDataStream::Ok) {
+        f.cancelWriting();
+        return false;
+    }
+    return f.commit();
+}
+
+int DatasetManifest::countLabelLines(const QString &labelPath)
+{
+    QFile f(labelPath);
+    if (!f.open(QIODevice::ReadOnly))
+        return -1;
+    // Valid boxes only, same as what loadLabelData would show
+    const QByteArray data = f.readAll();
+    QVector<YoloLabel> boxes;
+    return parseYoloLabels(data.constData(), data.size(), boxes);
+}
+
+ImageList DatasetManifest::reconcile(const QString &dir, const QString &labelDir,
+                                     const ImageList &known, bool relist,
+                                     const std::atomic_bool &cancel)
+{
+    ImageList list = known;   // implicitly shared until written to
+    if (relist) {
+        ImageList listed;
+        const QStringList names = QDir(dir).entryList(ImageDirIndex::nameFilters(), QDir::Files);
+        for (const QString &name : names) {
+            const int k = known.indexOf(name);
+            listed.append(name, k >= 0 ? known.meta(k) : ImageMeta());
+        }
+        listed.sort();
+        list = std::move(listed);
+    }
+
+    const QDir imgDir(dir);
+    const QDir lblDir(labelDir);
+
+    for (int i = 0; i < list.size(); ) {
+        if (cancel.load(std::memory_order_relaxed))
+            break;
+
+        const QString name = list.name(i);
+        const QFileInfo fi(imgDir.filePath(name));
+        if (!fi.exists()) {
+            list.removeAt(i);   // removed since it was listed
+            continue;
+        }
+
+        ImageMeta &e = list.meta(i);
+        const qint64 mtime = fi.lastModified().toMSecsSinceEpoch();
+        const qint64 size  = fi.size();
+        if (e.mtime != mtime || e.size != size) {
+            e.mtime = mtime;
+            e.size  = size;
+            const QSize sz = QImageReader(fi.filePath()).size();   // header only
+            e.width  = sz.width();
+            e.height = sz.height();
+        }
+
+        if (!labelDir.isEmpty()) {
+            const QFileInfo li(lblDir.filePath(QFileInfo(name).completeBaseName() + ".txt"));
+            const qint64 lm = li.exists() ? li.lastModified().toMSecsSinceEpoch() : -1;
+            if (lm != e.labelMtime) {
+                e.labelMtime = lm;
+                e.boxes = lm < 0 ? -1 : countLabelLines(li.filePath());
+            }
+        }
+        ++i;
+    }
+    return list;
+}
@@ -0,0 +1,33 @@
+#ifndef DATASET_MANIFEST_H
+#define DATASET_MANIFEST_H
+
+#include <QString>
+
+#include "image_list.h"
+
+#include <atomic>
+
+// Binary snapshot of a dataset directory ("<dir>/.yololabel.manifest") so
+// reopening a huge folder doesn't have to list, sort and stat it before the
+// first image shows. Entries are stored in index (sort key) order.
+class DatasetManifest
+{
+public:
+    static QString pathFor(const QString &dir);
+
+    static bool load(const QString &dir, ImageList &list);
+    static bool save(const QString &dir, const ImageList &list);
+
+    // `known` brought up to date with the directory: vanished files dropped,
+    // (if `relist`) new ones added, and dimensions / label summaries re-read
+    // only where stamps moved. Meant for a worker thread; stops early and
+    // returns a partial result once `cancel` is set.
+    static ImageList reconcile(const QString &dir, const QString &labelDir,
+                               const ImageList &known, bool relist,
+                               const std::atomic_bool &cancel);
+
+    // Number of valid boxes in a label file, -1 if it can't be read
+    static int countLabelLines(const QString &labelPath);
+};
+
+#endif // DATASET_MANIFEST_H
@@ -0,0 +1,21 @@
+#ifndef DECODED_IMAGE_H
+#define DECODED_IMAGE_H
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+// A decoded image as handed from the decoder/cache to label_img. `image` may
+// be a reduced, screen-sized decode; `fullSize` is always the size of the
+// image at full resolution (after EXIF orientation).
+struct DecodedImage
+{
+    QString path;
+    QImage  image;
+    QSize   fullSize;
+
+    bool isNull() const    { return image.isNull(); }
+    bool isReduced() const { return !image.isNull() && image.size() != fullSize; }
+};
+
+#endif // DECODED_IMAGE_H
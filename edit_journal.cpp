@@ -0,0 +1,429 @@
+#include "edit_journal.h"
+#include "label_writer.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QSaveFile>
+#include <QtEndian>
+#include <algorithm>
+
+static const quint32 kJournalMagic   = 0x594C4A4E;   // "YLJN"
+static const quint32 kJournalVersion = 1;
+static const qint64  kHeaderBytes    = 8;
+static const qint64  kCompactBytes   = 4 << 20;      // rewrite once this much has piled up
+
+static quint16 checksumOf(const QByteArray &body)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    return qChecksum(body);
+#else
+    return qChecksum(body.constData(), uint(body.size()));
+#endif
+}
+
+static void putLabel(QDataStream &out, const YoloLabel &l)
+{
+    out << qint32(l.cls) << l.cx << l.cy << l.w << l.h << l.conf;
+}
+
+static YoloLabel getLabel(QDataStream &in)
+{
+    YoloLabel l;
+    qint32 cls = 0;
+    in >> cls >> l.cx >> l.cy >> l.w >> l.h >> l.conf;
+    l.cls = cls;
+    return l;
+}
+
+static void putLabels(QDataStream &out, const QVector<YoloLabel> &labels)
+{
+    out << quint32(labels.size());
+    for (const YoloLabel &l : labels)
+        putLabel(out, l);
+}
+
+static QVector<YoloLabel> getLabels(QDataStream &in)
+{
+    quint32 n = 0;
+    in >> n;
+    QVector<YoloLabel> labels;
+    labels.reserve(int(std::min<quint32>(n, 1u << 20)));
+    for (quint32 i = 0; i < n && in.status() == QDataStream::Ok; ++i)
+        labels.push_back(getLabel(in));
+    return labels;
+}
+
+EditJournal::EditJournal(LabelWriter *writer, QObject *parent)
+    : QObject(parent), m_writer(writer)
+{
+    connect(m_writer, &LabelWriter::written, this, &EditJournal::onWritten);
+}
+
+EditJournal::~EditJournal()
+{
+    close();
+}
+
+int EditJournal::open(const QString &dir)
+{
+    close();
+    m_file.setFileName(QDir(dir).filePath(".yololabel.journal"));
+
+    QHash<quint32, Section> live;
+    if (m_file.open(QIODevice::ReadOnly)) {
+        replay(m_file.readAll(), live);
+        m_file.close();
+    }
+
+    // Later sections of a file were built on top of earlier ones
+    QHash<QString, quint32> newest;
+    for (auto it = live.cbegin(); it != live.cend(); ++it)
+        if (it.key() > newest.value(it->path, 0))
+            newest.insert(it->path, it.key());
+
+    for (quint32 id : std::as_const(newest))
+        m_sections.insert(m_nextId++, live.value(id));
+    if (m_sections.isEmpty())
+        return 0;
+
+    compact();
+    for (auto it = m_sections.cbegin(); it != m_sections.cend(); ++it)
+        m_awaiting[it->path].append(qMakePair(m_writer->save(it->path, it->labels), it.key()));
+
+    qDebug() << "[journal] recovered unsaved labels for" << m_sections.size() << "images in" << dir;
+    return m_sections.size();
+}
+
+void EditJournal::close()
+{
+    if (m_file.fileName().isEmpty())
+        return;
+
+    abandonOpen();
+    // Saves still queued land now; take their written() before deciding
+    m_writer->flush();
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+    maybeCompact();
+
+    m_file.close();
+    m_file.setFileName(QString());
+    m_target.clear();
+    m_base.clear();
+    m_sections.clear();
+    m_awaiting.clear();
+    m_nextId = 1;
+}
+
+void EditJournal::setTarget(const QString &labelPath, const QVector<YoloLabel> &base)
+{
+    abandonOpen();
+    m_target = labelPath;
+    m_base   = base;
+}
+
+void EditJournal::added(const YoloLabel &label)
+{
+    if (!ensureSection())
+        return;
+    m_sections[m_open].labels.push_back(label);
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << m_open;
+    putLabel(out, label);
+    append(Add, payload);
+}
+
+void EditJournal::changed(int index, const YoloLabel &label)
+{
+    if (!ensureSection())
+        return;
+    QVector<YoloLabel> &labels = m_sections[m_open].labels;
+    if (index < 0 || index >= labels.size())
+        return;
+    labels[index] = label;
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << m_open << quint32(index);
+    putLabel(out, label);
+    append(Change, payload);
+}
+
+void EditJournal::removed(int index)
+{
+    if (!ensureSection())
+        return;
+    QVector<YoloLabel> &labels = m_sections[m_open].labels;
+    if (index < 0 || index >= labels.size())
+        return;
+    labels.remove(index);
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << m_open << quint32(index);
+    append(Remove, payload);
+}
+
+void EditJournal::replaced(const QVector<YoloLabel> &labels)
+{
+    if (!ensureSection())
+        return;
+    m_sections[m_open].labels = labels;
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << m_open;
+    putLabels(out, labels);
+    append(Replace, payload);
+}
+
+void EditJournal::saved(quint64 seq, const QVector<YoloLabel> &current)
+{
+    if (m_open) {
+        m_awaiting[m_target].append(qMakePair(seq, m_open));
+        m_open = 0;
+    }
+    m_base = current;
+}
+
+void EditJournal::discard(const QString &labelPath)
+{
+    if (m_target == labelPath)
+        m_open = 0;
+    m_awaiting.remove(labelPath);
+
+    QVector<quint32> ids;
+    for (auto it = m_sections.cbegin(); it != m_sections.cend(); ++it)
+        if (it->path == labelPath)
+            ids.push_back(it.key());
+    for (quint32 id : std::as_const(ids))
+        finish(id);
+    maybeCompact();
+}
+
+void EditJournal::onWritten(const QString &labelPath, quint64 seq)
+{
+    auto it = m_awaiting.find(labelPath);
+    if (it == m_awaiting.end())
+        return;
+
+    QVector<QPair<quint64, quint32>> &waiting = *it;
+    for (int i = 0; i < waiting.size(); ) {
+        if (waiting[i].first <= seq) {
+            finish(waiting[i].second);
+            waiting.remove(i);
+        } else {
+            ++i;
+        }
+    }
+    if (waiting.isEmpty())
+        m_awaiting.erase(it);
+    maybeCompact();
+}
+
+bool EditJournal::ensureSection()
+{
+    if (m_target.isEmpty() || m_file.fileName().isEmpty())
+        return false;
+    if (m_open)
+        return true;
+
+    m_open = m_nextId++;
+    const Section s{m_target, m_base};
+    m_sections.insert(m_open, s);
+    beginRecord(m_open, s);
+    return true;
+}
+
+void EditJournal::abandonOpen()
+{
+    if (!m_open)
+        return;
+    finish(m_open);
+    m_open = 0;
+}
+
+void EditJournal::finish(quint32 id)
+{
+    if (!m_sections.remove(id))
+        return;
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << id;
+    append(Done, payload);
+}
+
+QByteArray EditJournal::beginPayload(quint32 id, const Section &s)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << id << s.path.toUtf8();
+    putLabels(out, s.labels);
+    return payload;
+}
+
+void EditJournal::beginRecord(quint32 id, const Section &s)
+{
+    append(Begin, beginPayload(id, s));
+}
+
+static QByteArray journalHeader()
+{
+    uchar header[kHeaderBytes];
+    qToLittleEndian(kJournalMagic, header);
+    qToLittleEndian(kJournalVersion, header + 4);
+    return QByteArray(reinterpret_cast<const char *>(header), kHeaderBytes);
+}
+
+// Record: u32 length, then `length` bytes of type + payload, then a CRC-16
+// of those bytes. Replay stops at the first record that doesn't check out.
+static QByteArray recordFrame(quint8 type, const QByteArray &payload)
+{
+    QByteArray body;
+    body.reserve(payload.size() + 1);
+    body += char(type);
+    body += payload;
+
+    uchar len[4], crc[2];
+    qToLittleEndian(quint32(body.size()), len);
+    qToLittleEndian(checksumOf(body), crc);
+
+    QByteArray frame;
+    frame.reserve(body.size() + 6);
+    frame.append(reinterpret_cast<const char *>(len), 4);
+    frame += body;
+    frame.append(reinterpret_cast<const char *>(crc), 2);
+    return frame;
+}
+
+void EditJournal::append(Record type, const QByteArray &payload)
+{
+    if (!m_file.isOpen()) {
+        if (!m_file.open(QIODevice::ReadWrite)) {
+            qWarning() << "[journal] cannot open" << m_file.fileName() << ":" << m_file.errorString();
+            return;
+        }
+        m_file.resize(0);   // anything left there was replayed by open()
+        m_file.write(journalHeader());
+    }
+
+    m_file.write(recordFrame(type, payload));
+    m_file.flush();   // to the OS, one write() per record
+}
+
+void EditJournal::compact()
+{
+    QByteArray data = journalHeader();
+    for (auto it = m_sections.cbegin(); it != m_sections.cend(); ++it)
+        data += recordFrame(Begin, beginPayload(it.key(), *it));
+
+    // The old journal stays in place until the new one is complete on disk
+    const bool wasOpen = m_file.isOpen();
+    QSaveFile out(m_file.fileName());
+    bool ok = out.open(QIODevice::WriteOnly) && out.write(data) == data.size();
+    if (ok) {
+        m_file.close();   // Windows won't rename over an open file
+        ok = out.commit();
+    }
+    if (!ok)
+        qWarning() << "[journal] cannot compact" << m_file.fileName() << ":" << out.errorString();
+
+    if (!m_file.isOpen() && !m_file.open(QIODevice::ReadWrite)) {
+        qWarning() << "[journal] cannot open" << m_file.fileName() << ":" << m_file.errorString();
+        return;
+    }
+    if (!ok && !wasOpen) {
+        // Recovering in open(): the sections were renumbered, so the old
+        // file can't be appended to; rewrite it in place instead
+        m_file.resize(0);
+        m_file.write(data);
+        m_file.flush();
+        return;
+    }
+    m_file.seek(m_file.size());   // the compacted file, or the old one if that failed
+}
+
+void EditJournal::maybeCompact()
+{
+    if (!m_file.isOpen())
+        return;
+    if (m_sections.isEmpty()) {
+        // Everything is in the label files
+        m_file.resize(kHeaderBytes);
+        m_file.seek(kHeaderBytes);
+    } else if (m_file.size() > kCompactBytes) {
+        compact();
+    }
+}
+
+void EditJournal::replay(const QByteArray &data, QHash<quint32, Section> &live) const
+{
+    if (data.size() < kHeaderBytes)
+        return;
+    const uchar *p = reinterpret_cast<const uchar *>(data.constData());
+    if (qFromLittleEndian<quint32>(p) != kJournalMagic ||
+        qFromLittleEndian<quint32>(p + 4) != kJournalVersion) {
+        qWarning() << "[journal] unknown format, ignored:" << m_file.fileName();
+        return;
+    }
+
+    qint64 pos = kHeaderBytes;
+    while (pos + 4 <= data.size()) {
+        const quint32 len = qFromLittleEndian<quint32>(p + pos);
+        if (len == 0 || pos + 4 + qint64(len) + 2 > data.size())
+            break;   // torn tail of a record being written when we died
+        const QByteArray body = data.mid(pos + 4, len);
+        if (qFromLittleEndian<quint16>(p + pos + 4 + len) != checksumOf(body))
+            break;
+        pos += 4 + qint64(len) + 2;
+
+        QDataStream in(body);
+        quint8 type = 0;
+        quint32 id = 0;
+        in >> type >> id;
+
+        if (type == Begin) {
+            QByteArray path;
+            in >> path;
+            const QVector<YoloLabel> labels = getLabels(in);
+            if (in.status() == QDataStream::Ok)
+                live.insert(id, Section{QString::fromUtf8(path), labels});
+            continue;
+        }
+        if (type == Done) {
+            live.remove(id);
+            continue;
+        }
+
+        auto it = live.find(id);
+        if (it == live.end())
+            continue;
+        QVector<YoloLabel> &labels = it->labels;
+        quint32 index = 0;
+        switch (type) {
+        case Add:
+            labels.push_back(getLabel(in));
+            break;
+        case Change: {
+            in >> index;
+            const YoloLabel l = getLabel(in);
+            if (index < quint32(labels.size()))
+                labels[int(index)] = l;
+            break;
+        }
+        case Remove:
+            in >> index;
+            if (index < quint32(labels.size()))
+                labels.remove(int(index));
+            break;
+        case Replace:
+            labels = getLabels(in);
+            break;
+        default:
+            break;
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef EDIT_JOURNAL_H
+#define EDIT_JOURNAL_H
+
+#include <QObject>
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+#include "yolo_label_io.h"
+
+class LabelWriter;
+
+// Append-only log of box edits, <dataset>/.yololabel.journal, so a crash
+// doesn't lose the edits made since the last save. Each record goes to
+// the OS as soon as it's made (one small write, no fsync), which survives
+// the app dying though not the machine.
+//
+// Edits to one image between loads/saves form a section: the boxes as
+// they were, then add/change/remove records. A section is closed with a
+// "done" record once LabelWriter has put it on disk, or the user moved on
+// without saving. On open() whatever isn't done is replayed and handed to
+// the writer again; once every section is done the file is truncated.
+class EditJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit EditJournal(LabelWriter *writer, QObject *parent = nullptr);
+    ~EditJournal();
+
+    // Recovers edits left by a crash in `dir` and starts journaling there.
+    // Returns how many label files were recovered.
+    int  open(const QString &dir);
+    void close();
+
+    // Image being edited now; `base` is its boxes as loaded. Unsaved
+    // edits to the previous image are abandoned, as the UI drops them.
+    void setTarget(const QString &labelPath, const QVector<YoloLabel> &base);
+
+    void added(const YoloLabel &label);
+    void changed(int index, const YoloLabel &label);
+    void removed(int index);
+    void replaced(const QVector<YoloLabel> &labels);
+
+    // The target's edits went to LabelWriter as save `seq`; `current` is
+    // the new base for further edits.
+    void saved(quint64 seq, const QVector<YoloLabel> &current);
+
+    // Forget a label file altogether (its image is being deleted).
+    void discard(const QString &labelPath);
+
+private slots:
+    void onWritten(const QString &labelPath, quint64 seq);
+
+private:
+    struct Section {
+        QString path;
+        QVector<YoloLabel> labels;   // state after the last record, for compaction
+    };
+
+    enum Record : quint8 { Begin = 1, Add, Change, Remove, Replace, Done };
+
+    bool ensureSection();
+    void abandonOpen();
+    void finish(quint32 id);
+    void append(Record type, const QByteArray &payload);
+    static QByteArray beginPayload(quint32 id, const Section &s);
+    void beginRecord(quint32 id, const Section &s);
+    void compact();
+    void maybeCompact();
+    void replay(const QByteArray &data, QHash<quint32, Section> &live) const;
+
+    LabelWriter *m_writer;
+    QFile        m_file;
+
+    QString            m_target;
+    QVector<YoloLabel> m_base;
+    quint32            m_open = 0;        // section of m_target, 0 if no edits yet
+    quint32            m_nextId = 1;
+
+    QHash<quint32, Section> m_sections;   // not done yet
+    QHash<QString, QVector<QPair<quint64, quint32>>> m_awaiting;   // path -> (write seq, section)
+};
+
+#endif // EDIT_JOURNAL_H
@@ -0,0 +1,169 @@
+#include "gamma_lut.h"
+
+#include <QtConcurrent>
+#include <algorithm>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define LUT_X86_DISPATCH 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define LUT_NEON 1
+#endif
+
+typedef void (*LutKernel)(uchar *p, qsizetype n, const uchar *lut);
+
+static void lutScalar(uchar *p, qsizetype n, const uchar *lut)
+{
+    qsizetype i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const uchar a = lut[p[i + 0]];
+        const uchar b = lut[p[i + 1]];
+        const uchar c = lut[p[i + 2]];
+        const uchar d = lut[p[i + 3]];
+        p[i + 0] = a;
+        p[i + 1] = b;
+        p[i + 2] = c;
+        p[i + 3] = d;
+    }
+    for (; i < n; ++i)
+        p[i] = lut[p[i]];
+}
+
+#if LUT_X86_DISPATCH
+// pshufb looks up 16 entries at a time, so the 256-entry table is walked as
+// 16 slices. For slice h, idx = v - 16h lands in 0..15 only for bytes that
+// belong to it; a saturating +0x70 keeps those below 0x80 and pushes every
+// other byte to >= 0x80, which pshufb turns into 0. OR-ing the 16 partial
+// lookups gives the full result.
+__attribute__((target("ssse3")))
+static void lutSsse3(uchar *p, qsizetype n, const uchar *lut)
+{
+    __m128i tables[16];
+    for (int h = 0; h < 16; ++h)
+        tables[h] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lut + 16 * h));
+
+    const __m128i step = _mm_set1_epi8(16);
+    const __m128i bias = _mm_set1_epi8(0x70);
+
+    qsizetype i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i idx = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        __m128i r = _mm_setzero_si128();
+        for (int h = 0; h < 16; ++h) {
+            r = _mm_or_si128(r, _mm_shuffle_epi8(tables[h], _mm_adds_epu8(idx, bias)));
+            idx = _mm_sub_epi8(idx, step);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p + i), r);
+    }
+    lutScalar(p + i, n - i, lut);
+}
+
+__attribute__((target("avx2")))
+static void lutAvx2(uchar *p, qsizetype n, const uchar *lut)
+{
+    __m256i tables[16];
+    for (int h = 0; h < 16; ++h)
+        tables[h] = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(lut + 16 * h)));
+
+    const __m256i step = _mm256_set1_epi8(16);
+    const __m256i bias = _mm256_set1_epi8(0x70);
+
+    qsizetype i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+        __m256i r = _mm256_setzero_si256();
+        for (int h = 0; h < 16; ++h) {
+            r = _mm256_or_si256(r, _mm256_shuffle_epi8(tables[h], _mm256_adds_epu8(idx, bias)));
+            idx = _mm256_sub_epi8(idx, step);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p + i), r);
+    }
+    lutScalar(p + i, n - i, lut);
+}
+#endif
+
+#if LUT_NEON
+// tbl with four registers covers 64 entries and yields 0 for indices >= 64,
+// so four lookups at v, v-64, v-128, v-192 (wrapping) OR to the full table.
+static void lutNeon(uchar *p, qsizetype n, const uchar *lut)
+{
+    uint8x16x4_t t[4];
+    for (int k = 0; k < 4; ++k)
+        for (int j = 0; j < 4; ++j)
+            t[k].val[j] = vld1q_u8(lut + 64 * k + 16 * j);
+
+    const uint8x16_t step = vdupq_n_u8(64);
+
+    qsizetype i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t idx = vld1q_u8(p + i);
+        uint8x16_t r = vqtbl4q_u8(t[0], idx);
+        idx = vsubq_u8(idx, step);
+        r = vorrq_u8(r, vqtbl4q_u8(t[1], idx));
+        idx = vsubq_u8(idx, step);
+        r = vorrq_u8(r, vqtbl4q_u8(t[2], idx));
+        idx = vsubq_u8(idx, step);
+        r = vorrq_u8(r, vqtbl4q_u8(t[3], idx));
+        vst1q_u8(p + i, r);
+    }
+    lutScalar(p + i, n - i, lut);
+}
+#endif
+
+static LutKernel pickKernel()
+{
+#if LUT_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return lutAvx2;
+    if (__builtin_cpu_supports("ssse3"))
+        return lutSsse3;
+    return lutScalar;
+#elif LUT_NEON
+    return lutNeon;
+#else
+    return lutScalar;
+#endif
+}
+
+bool isIdentityLut(const uchar lut[256])
+{
+    for (int i = 0; i < 256; ++i)
+        if (lut[i] != i) return false;
+    return true;
+}
+
+void applyLut8(QImage &image, const uchar lut[256])
+{
+    if (image.isNull())
+        return;
+
+    static const LutKernel kernel = pickKernel();
+
+    // Row padding goes through the table too; it is never displayed, and this
+    // keeps every band one contiguous run of bytes.
+    const int h = image.height();
+    const qsizetype bpl = image.bytesPerLine();
+    uchar *bits = image.bits();
+
+    // Below ~1 MiB the thread hand-off costs more than it saves
+    const qsizetype minBandBytes = 1 << 20;
+    const int bands = int(std::clamp<qsizetype>(qsizetype(h) * bpl / minBandBytes,
+                                                1, QThreadPool::globalInstance()->maxThreadCount()));
+    if (bands == 1) {
+        kernel(bits, qsizetype(h) * bpl, lut);
+        return;
+    }
+
+    std::vector<std::pair<int, int>> rows;
+    rows.reserve(bands);
+    for (int b = 0; b < bands; ++b)
+        rows.emplace_back(int(qint64(h) * b / bands), int(qint64(h) * (b + 1) / bands));
+
+    QtConcurrent::blockingMap(rows, [=](const std::pair<int, int> &r) {
+        kernel(bits + qsizetype(r.first) * bpl, qsizetype(r.second - r.first) * bpl, lut);
+    });
+}
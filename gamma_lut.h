@@ -0,0 +1,14 @@
+#ifndef GAMMA_LUT_H
+#define GAMMA_LUT_H
+
+#include <QImage>
+
+// Maps every byte of `image` through `lut`, in place. All channels share the
+// table, so this is meant for 8-bit-per-channel formats without alpha
+// (RGB888 here). Uses SSSE3/AVX2 or NEON table lookups where available and
+// splits large images across the global thread pool by rows.
+void applyLut8(QImage &image, const uchar lut[256]);
+
+bool isIdentityLut(const uchar lut[256]);
+
+#endif // GAMMA_LUT_H
@@ -0,0 +1,97 @@
+#include "image_cache.h"
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <algorithm>
+#include <climits>
+
+ImageCache::ImageCache(qint64 budgetBytes)
+{
+    setBudget(budgetBytes);
+}
+
+ImageCache::Stamp ImageCache::stampOf(const QString &path)
+{
+    QFileInfo fi(path);
+    Stamp s;
+    if (fi.exists()) {
+        s.mtime = fi.lastModified().toMSecsSinceEpoch();
+        s.size  = fi.size();
+    }
+    return s;
+}
+
+int ImageCache::costOf(const QImage &img)
+{
+    return int(std::max<qint64>(1, img.sizeInBytes() >> 10));
+}
+
+void ImageCache::setBudget(qint64 bytes)
+{
+    QMutexLocker lock(&m_mutex);
+    const int before = m_cache.count();
+    m_cache.setMaxCost(int(std::clamp<qint64>(bytes >> 10, 0, INT_MAX)));
+    m_evictions += before - m_cache.count();
+}
+
+bool ImageCache::lookup(const QString &path, DecodedImage &out)
+{
+    const Stamp now = stampOf(path);
+
+    QMutexLocker lock(&m_mutex);
+    Entry *e = m_cache.object(path);   // also bumps it to most-recently-used
+    if (!e || e->stamp != now) {
+        if (e) m_cache.remove(path);   // file changed on disk since decode
+        ++m_misses;
+        return false;
+    }
+    ++m_hits;
+    out = e->image;
+    return true;
+}
+
+bool ImageCache::contains(const QString &path) const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_cache.contains(path);
+}
+
+void ImageCache::insert(const QString &path, const DecodedImage &img, const Stamp &stamp)
+{
+    if (img.isNull() || stamp.mtime < 0)
+        return;
+
+    QMutexLocker lock(&m_mutex);
+    const bool replacing = m_cache.contains(path);
+    const int before = m_cache.count() - (replacing ? 1 : 0);
+    m_cache.remove(path);
+    const bool inserted = m_cache.insert(path, new Entry{img, stamp}, costOf(img.image));
+    const int after = m_cache.count() - (inserted ? 1 : 0);
+    m_evictions += std::max(0, before - after);
+}
+
+void ImageCache::invalidate(const QString &path)
+{
+    QMutexLocker lock(&m_mutex);
+    m_cache.remove(path);
+}
+
+void ImageCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_cache.clear();
+}
+
+ImageCache::Stats ImageCache::stats() const
+{
+    QMutexLocker lock(&m_mutex);
+    Stats s;
+    s.hits      = m_hits;
+    s.misses    = m_misses;
+    s.evictions = m_evictions;
+    s.bytes     = qint64(m_cache.totalCost()) << 10;
+    s.budget    = qint64(m_cache.maxCost()) << 10;
+    s.count     = m_cache.count();
+    return s;
+}
@@ -0,0 +1,61 @@
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+
+#include "decoded_image.h"
+
+// Decoded images shared by navigation and the prefetcher, LRU-evicted under
+// a byte budget. An entry is only served while the file's mtime and size
+// still match what was decoded, so a rewritten file is never shown stale.
+// Thread-safe.
+class ImageCache
+{
+public:
+    struct Stamp {
+        qint64 mtime = -1;  // ms since epoch
+        qint64 size  = -1;
+        bool operator==(const Stamp &o) const { return mtime == o.mtime && size == o.size; }
+        bool operator!=(const Stamp &o) const { return !(*this == o); }
+    };
+
+    struct Stats {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        quint64 evictions = 0;
+        qint64  bytes = 0;
+        qint64  budget = 0;
+        int     count = 0;
+    };
+
+    explicit ImageCache(qint64 budgetBytes = 1024ll << 20);
+
+    static Stamp stampOf(const QString &path);
+
+    void   setBudget(qint64 bytes);
+    bool   lookup(const QString &path, DecodedImage &out);
+    bool   contains(const QString &path) const;
+    void   insert(const QString &path, const DecodedImage &img, const Stamp &stamp);
+    void   invalidate(const QString &path);
+    void   clear();
+    Stats  stats() const;
+
+private:
+    struct Entry {
+        DecodedImage image;
+        Stamp        stamp;
+    };
+
+    static int costOf(const QImage &img);   // KiB, QCache costs are int
+
+    mutable QMutex m_mutex;
+    QCache<QString, Entry> m_cache;
+    quint64 m_hits = 0;
+    quint64 m_misses = 0;
+    quint64 m_evictions = 0;
+};
+
+#endif // IMAGE_CACHE_H
@@ -0,0 +1,492 @@
+#include "image_dir_index.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QSocketNotifier>
+#include <QtConcurrent>
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+// Past this many additions one merge beats inserting one by one
+static const int kBulkInsert = 1024;
+
+ImageDirIndex::ImageDirIndex(QObject *parent)
+    : QObject(parent)
+{
+    // Bursts (copying a folder in) arrive as many notifications; list once
+    m_rescanTimer.setSingleShot(true);
+    m_rescanTimer.setInterval(300);
+    connect(&m_rescanTimer, &QTimer::timeout, this, &ImageDirIndex::rescan);
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &ImageDirIndex::onDirectoryChanged);
+    connect(&m_reconcileWatcher, &QFutureWatcher<ImageList>::finished,
+            this, &ImageDirIndex::onReconcileFinished);
+    connect(&m_rescanWatcher, &QFutureWatcher<QStringList>::finished,
+            this, &ImageDirIndex::onRescanListed);
+}
+
+ImageDirIndex::~ImageDirIndex()
+{
+    close();
+}
+
+const QStringList &ImageDirIndex::nameFilters()
+{
+    static const QStringList filters = {"*.jpg", "*.JPG", "*.jpeg", "*.JPEG",
+                                        "*.png", "*.PNG", "*.bmp", "*.BMP"};
+    return filters;
+}
+
+bool ImageDirIndex::isImageName(const QString &name) const
+{
+    for (const char *ext : {".jpg", ".jpeg", ".png", ".bmp"})
+        if (name.endsWith(QLatin1String(ext), Qt::CaseInsensitive))
+            return true;
+    return false;
+}
+
+QString ImageDirIndex::nameInDir(const QString &path) const
+{
+    // Paths handed out by at() are "<m_dir>/<name>"; anything else goes
+    // through QFileInfo to normalise it first
+    if (path.size() > m_dir.size() + 1 && path.startsWith(m_dir) &&
+        path.at(m_dir.size()) == '/' && path.indexOf('/', m_dir.size() + 1) < 0)
+        return path.mid(m_dir.size() + 1);
+
+    const QFileInfo fi(path);
+    return fi.absolutePath() == m_dir ? fi.fileName() : QString();
+}
+
+QStringList ImageDirIndex::listNames(const QString &dir)
+{
+    return QDir(dir).entryList(nameFilters(), QDir::Files);
+}
+
+bool ImageDirIndex::open(const QString &dir, const QString &labelDir)
+{
+    const QString absDir = QDir(dir).absolutePath();
+    if (!QFileInfo(absDir).isDir())
+        return false;
+
+    ImageList list;
+    const bool fromManifest = DatasetManifest::load(absDir, list) && !list.isEmpty();
+    if (fromManifest)
+        qDebug() << "[index] manifest:" << list.size() << "images in" << absDir
+                 << "," << (list.memoryBytes() >> 10) << "KiB";
+
+    close();
+    ++m_generation;
+    m_dir      = absDir;
+    m_labelDir = labelDir;
+    m_list     = std::move(list);
+    m_dirMtime = QFileInfo(m_dir).lastModified();
+    startWatching();
+
+    // First visit: stream the listing in; otherwise just verify the manifest
+    if (fromManifest)
+        startReconcile(true);
+    else
+        startEnumeration();
+    return true;
+}
+
+void ImageDirIndex::close()
+{
+    cancelEnumeration();
+    cancelReconcile();
+    stopWatching();
+    saveManifestIfDirty();
+    ++m_generation;
+    m_rescanAgain = false;
+    m_dir.clear();
+    m_labelDir.clear();
+    m_list.clear();
+}
+
+void ImageDirIndex::startEnumeration()
+{
+    auto cancel = std::make_shared<std::atomic_bool>(false);
+    m_enumCancel  = cancel;
+    m_enumerating = true;
+
+    const QString dir = m_dir;
+    m_enumFuture = QtConcurrent::run([this, dir, cancel]() {
+        // A small first batch gets the first image on screen quickly; later
+        // ones grow so merging them into the sorted index stays cheap. Slow
+        // (network) listings still flush a few times a second.
+        int batchSize = 256;
+        ImageList batch;
+        QElapsedTimer sinceFlush;
+        sinceFlush.start();
+
+        auto flush = [&](bool done) {
+            batch.sort();
+            QMetaObject::invokeMethod(this, [this, cancel, entries = std::move(batch), done]() {
+                if (!cancel->load())
+                    onEnumerated(entries, done);
+            }, Qt::QueuedConnection);
+            batch = ImageList();
+            sinceFlush.restart();
+        };
+
+        QDirIterator it(dir, nameFilters(), QDir::Files);
+        while (!cancel->load() && it.hasNext()) {
+            it.next();
+            batch.append(it.fileName());   // sort keys are made here, off the GUI thread
+            if (batch.size() >= batchSize || sinceFlush.elapsed() > 250) {
+                flush(false);
+                batchSize = std::min(batchSize * 2, 1 << 16);
+            }
+        }
+        if (!cancel->load())
+            flush(true);
+    });
+}
+
+void ImageDirIndex::cancelEnumeration()
+{
+    if (m_enumCancel)
+        m_enumCancel->store(true);
+    m_enumCancel.reset();
+    m_enumerating = false;
+    // The worker posts back to `this`; it must be gone before we are
+    m_enumFuture.waitForFinished();
+}
+
+void ImageDirIndex::onEnumerated(const ImageList &batch, bool done)
+{
+    if (!batch.isEmpty()) {
+        m_list.merge(batch);   // one linear pass, batches arrive sorted
+        m_manifestDirty = true;
+        emit changed();
+    }
+    if (!done)
+        return;
+
+    m_enumerating = false;
+    m_enumCancel.reset();
+    qDebug() << "[index] listed" << m_list.size() << "images in" << m_dir
+             << "," << (m_list.memoryBytes() >> 10) << "KiB";
+    emit enumerationFinished(m_list.size());
+
+    // Stamps, dimensions and label summaries, and the manifest for next time
+    if (!m_list.isEmpty())
+        startReconcile(false);
+}
+
+void ImageDirIndex::startReconcile(bool relist)
+{
+    cancelReconcile();
+
+    const QString dir = m_dir;
+    const QString labelDir = m_labelDir;
+    const ImageList known = m_list;   // implicitly shared
+    auto cancel = std::make_shared<std::atomic_bool>(false);
+    m_reconcileCancel = cancel;
+    m_changedDuringReconcile = false;
+    m_removedDuringReconcile.clear();
+    m_labelsDuringReconcile.clear();
+
+    m_reconcileWatcher.setFuture(QtConcurrent::run([=]() {
+        ImageList list = DatasetManifest::reconcile(dir, labelDir, known, relist, *cancel);
+        if (!cancel->load() && !DatasetManifest::save(dir, list))
+            qWarning() << "[index] could not write" << DatasetManifest::pathFor(dir);
+        return list;
+    }));
+}
+
+void ImageDirIndex::cancelReconcile()
+{
+    if (m_reconcileCancel)
+        m_reconcileCancel->store(true);
+    m_reconcileCancel.reset();
+}
+
+void ImageDirIndex::onReconcileFinished()
+{
+    // A cancelled run belongs to a directory we've since left
+    if (!m_reconcileCancel || m_reconcileCancel->load())
+        return;
+    m_reconcileCancel.reset();
+
+    m_list = m_reconcileWatcher.result();
+    m_manifestDirty = false;
+    qDebug() << "[index] reconciled" << m_list.size() << "images in" << m_dir;
+
+    // Deletions and label saves by the app since the snapshot was taken
+    for (const QString &name : std::as_const(m_removedDuringReconcile)) {
+        const int i = m_list.indexOf(name);
+        if (i >= 0) {
+            m_list.removeAt(i);
+            m_manifestDirty = true;
+        }
+    }
+    for (auto it = m_labelsDuringReconcile.cbegin(); it != m_labelsDuringReconcile.cend(); ++it) {
+        const int i = m_list.indexOf(it.key());
+        if (i < 0)
+            continue;
+        ImageMeta &e = m_list.meta(i);
+        e.boxes      = it.value().first;
+        e.labelMtime = it.value().second;
+        m_manifestDirty = true;
+    }
+    m_removedDuringReconcile.clear();
+    m_labelsDuringReconcile.clear();
+
+    // The listing is a snapshot; anything the watcher saw since then wins
+    if (m_changedDuringReconcile) {
+        m_dirMtime = QDateTime();
+        rescan();
+    }
+    emit changed();
+}
+
+void ImageDirIndex::saveManifestIfDirty()
+{
+    if (!m_manifestDirty || m_dir.isEmpty())
+        return;
+    m_manifestDirty = false;
+    if (!DatasetManifest::save(m_dir, m_list))
+        qWarning() << "[index] could not write" << DatasetManifest::pathFor(m_dir);
+}
+
+void ImageDirIndex::noteLabelSaved(const QString &imagePath, int boxes)
+{
+    const int i = indexOf(imagePath);
+    if (i < 0)
+        return;
+    ImageMeta &e = m_list.meta(i);
+    e.boxes      = boxes;
+    e.labelMtime = QDateTime::currentMSecsSinceEpoch();
+    m_manifestDirty = true;
+    if (m_reconcileCancel)
+        m_labelsDuringReconcile.insert(m_list.name(i), qMakePair(e.boxes, e.labelMtime));
+}
+
+int ImageDirIndex::indexOf(const QString &path) const
+{
+    const QString name = nameInDir(path);
+    return name.isEmpty() ? -1 : m_list.indexOf(name);
+}
+
+bool ImageDirIndex::remove(const QString &path)
+{
+    const int i = indexOf(path);
+    if (i < 0)
+        return false;
+    if (m_reconcileCancel) {
+        const QString name = m_list.name(i);
+        m_removedDuringReconcile.insert(name);
+        m_labelsDuringReconcile.remove(name);
+    }
+    m_list.removeAt(i);
+    m_manifestDirty = true;
+    return true;
+}
+
+bool ImageDirIndex::insertName(const QString &name)
+{
+    // Stamps and summary arrive with the next reconcile
+    if (m_list.insert(name) < 0)
+        return false;
+    m_manifestDirty = true;
+    m_changedDuringReconcile = true;
+    return true;
+}
+
+bool ImageDirIndex::removeName(const QString &name)
+{
+    const int i = m_list.indexOf(name);
+    if (i < 0)
+        return false;
+    m_list.removeAt(i);
+    m_manifestDirty = true;
+    m_changedDuringReconcile = true;
+    return true;
+}
+
+void ImageDirIndex::onDirectoryChanged()
+{
+    m_rescanTimer.start();
+}
+
+void ImageDirIndex::rescan()
+{
+    if (m_dir.isEmpty())
+        return;
+
+    // Label writes modify files in place and leave the directory mtime alone.
+    // A recent mtime is not trusted: coarse timestamps can hide a second change.
+    const QDateTime mtime = QFileInfo(m_dir).lastModified();
+    if (mtime.isValid() && mtime == m_dirMtime &&
+        mtime.secsTo(QDateTime::currentDateTime()) > 2)
+        return;
+    m_dirMtime = mtime;
+
+    // Listing a network share can take a while; keep it off the GUI thread
+    if (m_rescanWatcher.isRunning()) {
+        m_rescanAgain = true;
+        return;
+    }
+    m_rescanGeneration = m_generation;
+    m_rescanWatcher.setFuture(QtConcurrent::run(&ImageDirIndex::listNames, m_dir));
+}
+
+void ImageDirIndex::onRescanListed()
+{
+    if (m_rescanGeneration != m_generation)
+        return;   // listing of a directory we've since left
+
+    applyListing(m_rescanWatcher.result());
+
+    if (m_rescanAgain) {
+        m_rescanAgain = false;
+        m_dirMtime = QDateTime();
+        rescan();
+    }
+}
+
+void ImageDirIndex::applyListing(const QStringList &now)
+{
+    const QSet<QString> nowSet(now.begin(), now.end());
+
+    QStringList added;
+    for (const QString &n : now)
+        if (m_list.indexOf(n) < 0) added << n;
+    int removed = 0;
+    for (int i = m_list.size() - 1; i >= 0; --i) {
+        if (!nowSet.contains(m_list.name(i))) {
+            m_list.removeAt(i);
+            ++removed;
+        }
+    }
+    if (removed > 0) {
+        m_manifestDirty = true;
+        m_changedDuringReconcile = true;
+    }
+
+    if (added.size() > kBulkInsert) {
+        ImageList batch;
+        for (const QString &n : std::as_const(added))
+            batch.append(n);
+        batch.sort();
+        m_list.merge(batch);
+        m_manifestDirty = true;
+        m_changedDuringReconcile = true;
+    } else {
+        for (const QString &n : std::as_const(added))
+            insertName(n);
+    }
+
+    if (!added.isEmpty() || removed > 0) {
+        qDebug() << "[index]" << m_dir << "+" << added.size() << "-" << removed;
+        emit changed();
+    }
+}
+
+#ifdef Q_OS_LINUX
+
+void ImageDirIndex::startWatching()
+{
+    // inotify names the file in each event, so the index follows deltas
+    // without re-listing. Adds count once the file is complete (closed after
+    // writing, or renamed in), not at creation.
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd >= 0 &&
+        inotify_add_watch(m_inotifyFd, QFile::encodeName(m_dir).constData(),
+                          IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM |
+                          IN_DELETE_SELF | IN_ONLYDIR) >= 0) {
+        m_inotifyNotifier = new QSocketNotifier(m_inotifyFd, QSocketNotifier::Read, this);
+        connect(m_inotifyNotifier, &QSocketNotifier::activated, this, &ImageDirIndex::readInotify);
+        return;
+    }
+
+    qWarning() << "[index] inotify unavailable, falling back to QFileSystemWatcher:" << strerror(errno);
+    if (m_inotifyFd >= 0) {
+        ::close(m_inotifyFd);
+        m_inotifyFd = -1;
+    }
+    m_watcher.addPath(m_dir);
+}
+
+void ImageDirIndex::stopWatching()
+{
+    delete m_inotifyNotifier;
+    m_inotifyNotifier = nullptr;
+    if (m_inotifyFd >= 0) {
+        ::close(m_inotifyFd);
+        m_inotifyFd = -1;
+    }
+    if (!m_watcher.directories().isEmpty())
+        m_watcher.removePaths(m_watcher.directories());
+    m_rescanTimer.stop();
+}
+
+void ImageDirIndex::readInotify()
+{
+    alignas(struct inotify_event) char buf[16 * 1024];
+    bool dirty = false;
+    bool overflow = false;
+
+    for (;;) {
+        const ssize_t len = ::read(m_inotifyFd, buf, sizeof(buf));
+        if (len <= 0)
+            break;
+        for (const char *p = buf; p < buf + len; ) {
+            const auto *ev = reinterpret_cast<const struct inotify_event *>(p);
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_IGNORED)) {
+                overflow = true;
+                continue;
+            }
+            if (ev->len == 0 || (ev->mask & IN_ISDIR))
+                continue;
+
+            const QString name = QFile::decodeName(ev->name);
+            if (!isImageName(name))
+                continue;
+            if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                dirty |= insertName(name);
+            else if (ev->mask & (IN_DELETE | IN_MOVED_FROM))
+                dirty |= removeName(name);
+        }
+    }
+
+    // Events were dropped: only a full listing is trustworthy now
+    if (overflow) {
+        m_dirMtime = QDateTime();
+        rescan();
+        return;
+    }
+    if (dirty) {
+        m_dirMtime = QFileInfo(m_dir).lastModified();
+        emit changed();
+    }
+}
+
+#else
+
+void ImageDirIndex::startWatching()
+{
+    m_watcher.addPath(m_dir);
+}
+
+void ImageDirIndex::stopWatching()
+{
+    if (!m_watcher.directories().isEmpty())
+        m_watcher.removePaths(m_watcher.directories());
+    m_rescanTimer.stop();
+}
+
+#endif
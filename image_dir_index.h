@@ -0,0 +1,122 @@
+#ifndef IMAGE_DIR_INDEX_H
+#define IMAGE_DIR_INDEX_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QHash>
+#include <QPair>
+#include <QSet>
+
+#include "dataset_manifest.h"
+
+#include <atomic>
+#include <memory>
+
+class QSocketNotifier;
+
+// Sorted (natural order, see ImageList::sortKey) list of the images in one
+// directory, kept current from filesystem notifications: inotify deltas on
+// Linux, a debounced re-list and diff elsewhere. Navigation reads from it
+// without touching the disk, and no listing ever runs on the GUI thread.
+// The directory prefix is held once here; ImageList stores bare names.
+//
+// open() starts from the dataset manifest when there is one, so a huge
+// folder shows right away. Without one, the listing streams in from a
+// worker thread in batches (changed() after each, enumerationFinished() at
+// the end). Either way the directory is then stat'ed on a worker thread and
+// the index (and manifest) brought up to date.
+class ImageDirIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ImageDirIndex(QObject *parent = nullptr);
+    ~ImageDirIndex();
+
+    static const QStringList &nameFilters();
+
+    // Returns false (and leaves the current index alone) if `dir` isn't a
+    // directory. `labelDir` is where the .txt labels live, for the summaries.
+    bool open(const QString &dir, const QString &labelDir = QString());
+    void close();
+
+    bool isEnumerating() const { return m_enumerating; }
+
+    QString dir() const { return m_dir; }
+    int     size() const { return m_list.size(); }
+    bool    isEmpty() const { return m_list.isEmpty(); }
+    QString at(int i) const { return m_dir + '/' + m_list.name(i); }
+    const ImageMeta &meta(int i) const { return m_list.meta(i); }
+    ImageList snapshot() const { return m_list; }   // shares data until the index changes
+
+    int  indexOf(const QString &path) const;   // hashed, -1 if absent
+    bool remove(const QString &path);          // for deletions made by the app
+
+    // Keeps the label summary current for labels written by the app.
+    void noteLabelSaved(const QString &imagePath, int boxes);
+
+signals:
+    void changed();
+    void enumerationFinished(int count);
+
+private slots:
+    void onDirectoryChanged();
+    void rescan();
+    void onRescanListed();
+    void onReconcileFinished();
+
+private:
+    static QStringList listNames(const QString &dir);
+
+    bool isImageName(const QString &name) const;
+    QString nameInDir(const QString &path) const;   // empty unless directly in m_dir
+    bool insertName(const QString &name);
+    bool removeName(const QString &name);
+    void applyListing(const QStringList &now);
+    void startWatching();
+    void stopWatching();
+    void startEnumeration();
+    void cancelEnumeration();
+    void onEnumerated(const ImageList &batch, bool done);
+    void startReconcile(bool relist);
+    void cancelReconcile();
+    void saveManifestIfDirty();
+
+    QString     m_dir;
+    QString     m_labelDir;
+    ImageList   m_list;
+    QDateTime   m_dirMtime;    // entries changed iff the directory mtime did
+
+    QFileSystemWatcher m_watcher;
+    QTimer             m_rescanTimer;
+    QFutureWatcher<QStringList> m_rescanWatcher;
+    quint64 m_generation = 0;          // bumped per open/close; stale results are dropped
+    quint64 m_rescanGeneration = 0;
+    bool    m_rescanAgain = false;
+
+    QFuture<void>                     m_enumFuture;
+    std::shared_ptr<std::atomic_bool> m_enumCancel;
+    bool m_enumerating = false;
+
+    QFutureWatcher<ImageList>         m_reconcileWatcher;
+    std::shared_ptr<std::atomic_bool>      m_reconcileCancel;
+    bool m_changedDuringReconcile = false;
+    // App-side edits made while a reconcile runs, replayed onto its result
+    QSet<QString>                          m_removedDuringReconcile;
+    QHash<QString, QPair<qint32, qint64>>  m_labelsDuringReconcile;   // name -> boxes, labelMtime
+    bool m_manifestDirty = false;
+
+#ifdef Q_OS_LINUX
+    void readInotify();
+
+    int              m_inotifyFd = -1;
+    QSocketNotifier *m_inotifyNotifier = nullptr;
+#endif
+};
+
+#endif // IMAGE_DIR_INDEX_H
@@ -0,0 +1,305 @@
+#include "image_list.h"
+
+#include <QHash>
+#include <algorithm>
+#include <cstring>
+
+static bool keyLess(const char *a, int alen, const char *b, int blen)
+{
+    const int c = std::memcmp(a, b, size_t(std::min(alen, blen)));
+    return c != 0 ? c < 0 : alen < blen;
+}
+
+QByteArray ImageList::sortKey(const QString &name)
+{
+    // Case-folded UTF-8 with three classes, ordered like a numeric collator:
+    // ASCII punctuation (0x02 + the byte) < numbers < letters and non-ASCII.
+    // A digit run becomes 0x03, a length byte and the digits minus leading
+    // zeros, so a longer number is a bigger one. The raw name after a 0x00
+    // separator breaks ties ("img01" / "img1", "A" / "a") so the order is total.
+    const QByteArray folded = name.toCaseFolded().toUtf8();
+    const QByteArray raw = name.toUtf8();
+    const int n = folded.size();
+
+    QByteArray key;
+    key.reserve(n + raw.size() + 8);
+    for (int i = 0; i < n; ) {
+        const uchar c = uchar(folded.at(i));
+        if (c < '0' || c > '9') {
+            const bool punct = c < 0x80 && !(c >= 'a' && c <= 'z');
+            if (punct) key.append('\x02');
+            key.append(char(c));
+            ++i;
+            continue;
+        }
+        int first = i;
+        while (first < n && folded.at(first) == '0') ++first;
+        int end = first;
+        while (end < n && folded.at(end) >= '0' && folded.at(end) <= '9') ++end;
+        key.append('\x03');
+        key.append(char(std::min(end - first, 254) + 1));
+        key.append(folded.constData() + first, end - first);
+        i = end;
+    }
+    key.append('\0');
+    key.append(raw);
+    return key;
+}
+
+void ImageList::clear()
+{
+    *this = ImageList();
+}
+
+void ImageList::rawSpan(quint32 id, const char **name, int *len) const
+{
+    // The key's first 0x00 is the separator; the primary part never has one
+    const char *k = keyData(id);
+    const char *sep = static_cast<const char *>(std::memchr(k, 0, size_t(keyLen(id))));
+    *name = sep + 1;
+    *len  = int(k + keyLen(id) - sep - 1);
+}
+
+QByteArray ImageList::rawName(quint32 id) const
+{
+    const char *p;
+    int len;
+    rawSpan(id, &p, &len);
+    return QByteArray(p, len);
+}
+
+QString ImageList::name(int i) const
+{
+    return QString::fromUtf8(rawName(m_order.at(i)));
+}
+
+QByteArray ImageList::nameUtf8(int i) const
+{
+    return rawName(m_order.at(i));
+}
+
+bool ImageList::idLess(quint32 a, quint32 b) const
+{
+    return keyLess(keyData(a), keyLen(a), keyData(b), keyLen(b));
+}
+
+int ImageList::lowerBound(const QByteArray &key) const
+{
+    auto it = std::lower_bound(m_order.cbegin(), m_order.cend(), key,
+                               [this](quint32 id, const QByteArray &k) {
+                                   return keyLess(keyData(id), keyLen(id), k.constData(), k.size());
+                               });
+    return int(it - m_order.cbegin());
+}
+
+quint32 ImageList::addEntry(const QByteArray &key, const ImageMeta &meta)
+{
+    if (qint64(m_arena.size()) + key.size() > qint64(0xffffffffu))
+        qFatal("ImageList: name arena exceeds 4 GiB");
+
+    const quint32 id = quint32(m_keyOff.size());
+    m_keyOff.push_back(quint32(m_arena.size()));
+    m_keyLen.push_back(quint16(key.size()));
+    m_meta.push_back(meta);
+    m_arena.append(key);
+    m_pos.push_back(kEmpty);
+    hashInsert(id);
+    return id;
+}
+
+void ImageList::syncPositions() const
+{
+    for (int p = m_posFrom; p < m_order.size(); ++p)
+        m_pos[m_order.at(p)] = quint32(p);
+    m_posFrom = m_order.size();
+}
+
+int ImageList::indexOf(const QString &name) const
+{
+    const int id = findId(name.toUtf8());
+    if (id < 0)
+        return -1;
+    if (m_posFrom < m_order.size())
+        syncPositions();
+    return int(m_pos.at(id));
+}
+
+int ImageList::insert(const QString &name, const ImageMeta &meta)
+{
+    if (findId(name.toUtf8()) >= 0)
+        return -1;
+    const QByteArray key = sortKey(name);
+    const int p = lowerBound(key);
+    m_order.insert(p, addEntry(key, meta));
+    invalidatePositions(p);
+    return p;
+}
+
+void ImageList::removeAt(int i)
+{
+    const quint32 id = m_order.at(i);
+    hashRemove(id);
+    m_order.removeAt(i);
+    m_pos[id] = kEmpty;
+    m_deadBytes += keyLen(id);
+    m_keyLen[id] = 0;
+    invalidatePositions(i);
+    compactIfSparse();
+}
+
+void ImageList::append(const QString &name, const ImageMeta &meta)
+{
+    if (findId(name.toUtf8()) >= 0)
+        return;
+    const quint32 id = addEntry(sortKey(name), meta);
+    m_pos[id] = quint32(m_order.size());
+    m_order.push_back(id);
+}
+
+void ImageList::sort()
+{
+    auto less = [this](quint32 a, quint32 b) { return idLess(a, b); };
+    if (std::is_sorted(m_order.cbegin(), m_order.cend(), less))   // listings often arrive sorted
+        return;
+    std::sort(m_order.begin(), m_order.end(), less);
+    invalidatePositions(0);
+}
+
+void ImageList::merge(const ImageList &other)
+{
+    QVector<quint32> merged;
+    merged.reserve(m_order.size() + other.size());
+
+    int a = 0;
+    for (int b = 0; b < other.size(); ++b) {
+        const quint32 ob = other.m_order.at(b);
+        const char *bk = other.keyData(ob);
+        const int   bl = other.keyLen(ob);
+        while (a < m_order.size() && keyLess(keyData(m_order.at(a)), keyLen(m_order.at(a)), bk, bl))
+            merged.push_back(m_order.at(a++));
+        if (a < m_order.size() && keyLen(m_order.at(a)) == bl &&
+            std::memcmp(keyData(m_order.at(a)), bk, size_t(bl)) == 0)
+            continue;   // already known
+        merged.push_back(addEntry(QByteArray::fromRawData(bk, bl), other.m_meta.at(ob)));
+    }
+    while (a < m_order.size())
+        merged.push_back(m_order.at(a++));
+
+    m_order = std::move(merged);
+    invalidatePositions(0);
+}
+
+void ImageList::compactIfSparse()
+{
+    if (m_deadBytes < (1 << 20) || m_deadBytes * 2 < m_arena.size())
+        return;
+
+    // Renumber live entries in order; ids, arena and hash start over
+    ImageList fresh;
+    fresh.m_arena.reserve(int(m_arena.size() - m_deadBytes));
+    fresh.m_order.reserve(m_order.size());
+    for (quint32 id : std::as_const(m_order)) {
+        const quint32 nid = fresh.addEntry(QByteArray::fromRawData(keyData(id), keyLen(id)), m_meta.at(id));
+        fresh.m_order.push_back(nid);
+    }
+    *this = std::move(fresh);
+}
+
+qint64 ImageList::memoryBytes() const
+{
+    return qint64(m_arena.capacity())
+         + qint64(m_keyOff.capacity()) * qint64(sizeof(quint32))
+         + qint64(m_keyLen.capacity()) * qint64(sizeof(quint16))
+         + qint64(m_meta.capacity())   * qint64(sizeof(ImageMeta))
+         + qint64(m_order.capacity())  * qint64(sizeof(quint32))
+         + qint64(m_pos.capacity())    * qint64(sizeof(quint32))
+         + qint64(m_slots.capacity())  * qint64(sizeof(quint32));
+}
+
+// --- hash of ids, keyed by the raw name (linear probing) ---
+
+size_t ImageList::hashOf(const char *name, int len) const
+{
+    return size_t(qHashBits(name, size_t(len)));
+}
+
+size_t ImageList::hashOfId(quint32 id) const
+{
+    const char *p;
+    int len;
+    rawSpan(id, &p, &len);
+    return hashOf(p, len);
+}
+
+int ImageList::findId(const QByteArray &utf8Name) const
+{
+    if (m_slots.isEmpty())
+        return -1;
+    const size_t mask = size_t(m_slots.size() - 1);
+    for (size_t s = hashOf(utf8Name.constData(), utf8Name.size()) & mask; ; s = (s + 1) & mask) {
+        const quint32 id = m_slots.at(int(s));
+        if (id == kEmpty)
+            return -1;
+        const char *p;
+        int len;
+        rawSpan(id, &p, &len);
+        if (len == utf8Name.size() && std::memcmp(p, utf8Name.constData(), size_t(len)) == 0)
+            return int(id);
+    }
+}
+
+void ImageList::hashInsert(quint32 id)
+{
+    // Keep the load factor at or below 1/2 (counting removed ids too, so
+    // a merge that hasn't published its order yet can't overfill it)
+    if ((int(id) + 1) * 2 > m_slots.size())
+        rehash((int(id) + 1) * 2, id);
+
+    const size_t mask = size_t(m_slots.size() - 1);
+    size_t s = hashOfId(id) & mask;
+    while (m_slots.at(int(s)) != kEmpty)
+        s = (s + 1) & mask;
+    m_slots[int(s)] = id;
+}
+
+void ImageList::hashRemove(quint32 id)
+{
+    const size_t mask = size_t(m_slots.size() - 1);
+    size_t i = hashOfId(id) & mask;
+    while (m_slots.at(int(i)) != id)
+        i = (i + 1) & mask;
+
+    // Backward-shift deletion: pull later members of the probe run into the
+    // hole unless that would move them in front of their home slot.
+    for (size_t j = i; ; ) {
+        j = (j + 1) & mask;
+        const quint32 other = m_slots.at(int(j));
+        if (other == kEmpty)
+            break;
+        const size_t home = hashOfId(other) & mask;
+        const bool movable = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+        if (movable) {
+            m_slots[int(i)] = other;
+            i = j;
+        }
+    }
+    m_slots[int(i)] = kEmpty;
+}
+
+void ImageList::rehash(int minCapacity, quint32 idLimit)
+{
+    int cap = 16;
+    while (cap < minCapacity)
+        cap <<= 1;
+    m_slots.fill(kEmpty, cap);
+
+    const size_t mask = size_t(cap - 1);
+    for (quint32 id = 0; id < idLimit; ++id) {
+        if (m_keyLen.at(id) == 0)
+            continue;
+        size_t s = hashOfId(id) & mask;
+        while (m_slots.at(int(s)) != kEmpty)
+            s = (s + 1) & mask;
+        m_slots[int(s)] = id;
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef IMAGE_LIST_H
+#define IMAGE_LIST_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include <algorithm>
+
+// What we know about one image of the dataset. Dimensions and the label
+// summary are refreshed only when the file's mtime/size (or the label
+// file's mtime) moved since they were read.
+struct ImageMeta {
+    qint64 mtime = -1;         // ms since epoch, -1 = not stat'ed yet
+    qint64 size  = -1;
+    qint32 width  = 0;         // as stored, before EXIF orientation
+    qint32 height = 0;
+    qint32 boxes = -1;         // lines in the label file, -1 = no label file
+    qint64 labelMtime = -1;
+};
+Q_DECLARE_TYPEINFO(ImageMeta, Q_PRIMITIVE_TYPE);
+
+// Sorted file names of one directory, stored compactly enough for millions
+// of entries: each name lives once in a byte arena as its natural-order sort
+// key (which ends with the raw UTF-8 name), the order is an array of 32-bit
+// ids, and an open-addressing table of ids hashes the names for O(1)
+// indexOf(). The directory prefix is kept by the owner, not per entry.
+class ImageList
+{
+public:
+    // Natural-order key: plain byte comparison of two keys orders the names
+    // like a numeric collator would ("img2" < "img10"), case-insensitively.
+    static QByteArray sortKey(const QString &name);
+
+    int  size() const { return m_order.size(); }
+    bool isEmpty() const { return m_order.isEmpty(); }
+    void clear();
+
+    QString    name(int i) const;
+    QByteArray nameUtf8(int i) const;
+    const ImageMeta &meta(int i) const { return m_meta.at(m_order.at(i)); }
+    ImageMeta       &meta(int i)       { return m_meta[m_order.at(i)]; }
+
+    // -1 if absent. Updates the cached positions after edits, so one list
+    // must not be read from two threads at once (copies are fine)
+    int  indexOf(const QString &name) const;
+    int  insert(const QString &name, const ImageMeta &meta = ImageMeta());   // -1 if present
+    void removeAt(int i);
+
+    // Bulk building: append in any order (duplicates are skipped), then
+    // sort() once. merge() folds in another sorted list in one pass.
+    void append(const QString &name, const ImageMeta &meta = ImageMeta());
+    void sort();
+    void merge(const ImageList &other);
+
+    qint64 memoryBytes() const;
+
+private:
+    static const quint32 kEmpty = 0xffffffffu;
+
+    const char *keyData(quint32 id) const { return m_arena.constData() + m_keyOff.at(id); }
+    int         keyLen(quint32 id) const  { return m_keyLen.at(id); }
+    void        rawSpan(quint32 id, const char **name, int *len) const;
+    QByteArray  rawName(quint32 id) const;
+    bool        idLess(quint32 a, quint32 b) const;
+    int         lowerBound(const QByteArray &key) const;
+
+    quint32 addEntry(const QByteArray &key, const ImageMeta &meta);
+    void    invalidatePositions(int from) { m_posFrom = std::min(m_posFrom, from); }
+    void    syncPositions() const;
+    void    compactIfSparse();
+
+    size_t  hashOf(const char *name, int len) const;
+    size_t  hashOfId(quint32 id) const;
+    int     findId(const QByteArray &utf8Name) const;   // id or -1
+    void    hashInsert(quint32 id);
+    void    hashRemove(quint32 id);
+    void    rehash(int minCapacity, quint32 idLimit);   // re-adds live ids below idLimit
+
+    QByteArray         m_arena;     // sort keys back to back
+    QVector<quint32>   m_keyOff;    // by id
+    QVector<quint16>   m_keyLen;    // by id, 0 = removed
+    QVector<ImageMeta> m_meta;      // by id
+    QVector<quint32>   m_order;     // ids in sort order
+    // Position of each id in m_order, brought up to date by indexOf():
+    // a run of inserts/removals costs one pass, not one each
+    mutable QVector<quint32> m_pos;
+    mutable int        m_posFrom = 0;   // m_pos may be stale from here on
+    QVector<quint32>   m_slots;     // hash table of ids, kEmpty = free
+    qint64 m_deadBytes = 0;         // arena bytes of removed entries
+};
+
+#endif // IMAGE_LIST_H
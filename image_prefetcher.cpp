@@ -0,0 +1,118 @@
+#include "image_prefetcher.h"
+#include "image_cache.h"
+#include "image_dir_index.h"
+#include "label_img.h"
+
+#include <QSet>
+#include <QtConcurrent>
+#include <algorithm>
+
+ImagePrefetcher::ImagePrefetcher(ImageCache *cache, QObject *parent)
+    : QObject(parent), m_cache(cache)
+{
+    // Leave cores for the GUI thread and inference
+    m_pool.setMaxThreadCount(std::clamp(QThread::idealThreadCount() / 2, 1, 2));
+    m_decodeSize = label_img::displayDecodeSize();
+}
+
+ImagePrefetcher::~ImagePrefetcher()
+{
+    clear();
+    m_pool.waitForDone();
+}
+
+void ImagePrefetcher::setWindow(int ahead, int behind)
+{
+    m_ahead  = std::max(0, ahead);
+    m_behind = std::max(0, behind);
+}
+
+void ImagePrefetcher::prefetchAround(const ImageDirIndex &list, int index, int direction)
+{
+    if (index < 0 || index >= list.size())
+        return;
+
+    const int step = direction < 0 ? -1 : +1;
+
+    // Nearest first so the likely next image is decoded before the rest
+    QStringList wanted;
+    wanted << list.at(index);
+    for (int i = 1; i <= std::max(m_ahead, m_behind); ++i) {
+        const int fwd = index + i * step;
+        const int back = index - i * step;
+        if (i <= m_ahead  && fwd  >= 0 && fwd  < list.size()) wanted << list.at(fwd);
+        if (i <= m_behind && back >= 0 && back < list.size()) wanted << list.at(back);
+    }
+
+    // Finished jobs already handed their image to the cache
+    const QSet<QString> keep(wanted.begin(), wanted.end());
+    for (auto it = m_jobs.begin(); it != m_jobs.end(); ) {
+        const bool done = it->future.isFinished();
+        if (done || !keep.contains(it.key())) {
+            it->cancelled->store(true);
+            it = m_jobs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (const QString &path : std::as_const(wanted))
+        if (!m_jobs.contains(path) && !m_cache->contains(path))
+            schedule(path);
+}
+
+void ImagePrefetcher::schedule(const QString &path)
+{
+    Job job;
+    job.cancelled = std::make_shared<std::atomic_bool>(false);
+    auto cancelled = job.cancelled;
+    ImageCache *cache = m_cache;
+    const QSize decodeSize = m_decodeSize;
+    job.future = QtConcurrent::run(&m_pool, [path, cancelled, cache, decodeSize]() {
+        if (cancelled->load())
+            return DecodedImage();
+        // Stamp before decoding so a rewrite during the decode reads as stale
+        const ImageCache::Stamp stamp = ImageCache::stampOf(path);
+        DecodedImage img = label_img::decodeImage(path, decodeSize);
+        cache->insert(path, img, stamp);
+        return img;
+    });
+    m_jobs.insert(path, job);
+}
+
+DecodedImage ImagePrefetcher::load(const QString &path)
+{
+    DecodedImage img;
+    if (m_cache->lookup(path, img))
+        return img;
+
+    auto it = m_jobs.find(path);
+    if (it != m_jobs.end()) {
+        img = it->future.result();   // blocks until the decode is done
+        m_jobs.erase(it);
+        if (!img.isNull())
+            return img;
+    }
+
+    const ImageCache::Stamp stamp = ImageCache::stampOf(path);
+    img = label_img::decodeImage(path, m_decodeSize);
+    m_cache->insert(path, img, stamp);
+    return img;
+}
+
+void ImagePrefetcher::invalidate(const QString &path)
+{
+    auto it = m_jobs.find(path);
+    if (it != m_jobs.end()) {
+        it->cancelled->store(true);
+        m_jobs.erase(it);
+    }
+    m_cache->invalidate(path);
+}
+
+void ImagePrefetcher::clear()
+{
+    for (const Job &job : std::as_const(m_jobs))
+        job.cancelled->store(true);
+    m_jobs.clear();
+}
@@ -0,0 +1,58 @@
+#ifndef IMAGE_PREFETCHER_H
+#define IMAGE_PREFETCHER_H
+
+#include <QObject>
+#include <QImage>
+#include <QHash>
+#include <QFuture>
+#include <QThreadPool>
+#include <QStringList>
+
+#include "decoded_image.h"
+
+#include <atomic>
+#include <memory>
+
+class ImageCache;
+class ImageDirIndex;
+
+// Decodes the images around the current one on worker threads into the shared
+// ImageCache so next/prev can show an already-decoded QImage. The window leans
+// towards the direction of travel: `ahead` entries that way, `behind` the other.
+class ImagePrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ImagePrefetcher(ImageCache *cache, QObject *parent = nullptr);
+    ~ImagePrefetcher();
+
+    void setWindow(int ahead, int behind);
+
+    // Schedules decodes around `index` and cancels queued ones outside the window.
+    void prefetchAround(const ImageDirIndex &list, int index, int direction);
+
+    // Decoded image for `path`: from the cache, from a decode already in
+    // flight (waits for it), or decoded right here as a last resort.
+    DecodedImage load(const QString &path);
+
+    void invalidate(const QString &path);
+    void clear();
+
+private:
+    struct Job {
+        QFuture<DecodedImage> future;
+        std::shared_ptr<std::atomic_bool> cancelled;
+    };
+
+    void schedule(const QString &path);
+
+    ImageCache       *m_cache;
+    QThreadPool       m_pool;
+    QHash<QString, Job> m_jobs;
+    QSize m_decodeSize;   // screen-sized preview, see label_img::displayDecodeSize
+    int m_ahead  = 2;
+    int m_behind = 1;
+};
+
+#endif // IMAGE_PREFETCHER_H
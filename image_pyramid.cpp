@@ -0,0 +1,20 @@
+#include "image_pyramid.h"
+
+#include <algorithm>
+
+QVector<QImage> buildImagePyramid(const QImage &base, int minSide)
+{
+    QVector<QImage> levels;
+    if (base.isNull())
+        return levels;
+
+    // Each level halves the previous one, so every step is a cheap 2:1 reduction
+    QImage prev = base;
+    while (std::min(prev.width(), prev.height()) / 2 >= minSide) {
+        prev = prev.scaled(prev.width() / 2, prev.height() / 2,
+                           Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+                   .convertToFormat(QImage::Format_RGB888);
+        levels.push_back(prev);
+    }
+    return levels;
+}
@@ -0,0 +1,12 @@
+#ifndef IMAGE_PYRAMID_H
+#define IMAGE_PYRAMID_H
+
+#include <QImage>
+#include <QVector>
+
+// Successive 1/2 downsamples of `base` (1/2, 1/4, 1/8, ...), stopping once the
+// shorter side would drop below `minSide`. `base` itself is not included.
+// Safe to run on a worker thread.
+QVector<QImage> buildImagePyramid(const QImage &base, int minSide = 256);
+
+#endif // IMAGE_PYRAMID_H
@@ -0,0 +1,310 @@
+#include "label_exporter.h"
+#include "annotation_store.h"
+#include "yolo_label_io.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QTemporaryFile>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+
+// Images parsed per parallel pass; bounds memory, keeps output in order
+static const int kChunk = 1024;
+
+struct LabelExporter::Item {
+    QString name;
+    int     width = 0;
+    int     height = 0;
+    QVector<YoloLabel> labels;
+    int     boxes = 0;        // labels.size() before VOC drops them
+    bool    hasLabel = false;
+    bool    ok = true;        // VOC file written
+    int     malformed = 0;
+    qint64  bytes = 0;
+};
+
+static QByteArray jsonString(const QString &s)
+{
+    const QByteArray utf8 = s.toUtf8();
+    QByteArray out;
+    out.reserve(utf8.size() + 2);
+    out += '"';
+    for (char c : utf8) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (uchar(c) < 0x20) {
+            out += "\\u00";
+            out += QByteArray::number(uchar(c), 16).rightJustified(2, '0');
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+    return out;
+}
+
+static QByteArray num(double v)
+{
+    return QByteArray::number(v, 'f', 2);
+}
+
+LabelExporter::LabelExporter(const QString &imageDir, const ImageList &images,
+                             const QString &labelDir, const QStringList &classNames)
+    : m_imageDir(imageDir), m_images(images), m_labelDir(labelDir), m_classNames(classNames)
+{
+}
+
+LabelExporter::Item LabelExporter::load(int index) const
+{
+    Item item;
+    item.name = m_images.name(index);
+
+    const ImageMeta &meta = m_images.meta(index);
+    if (meta.width > 0 && meta.height > 0) {
+        item.width  = meta.width;
+        item.height = meta.height;
+    } else {
+        // Not reconciled yet: header only, oriented like label_img shows it
+        QImageReader reader(QDir(m_imageDir).filePath(item.name));
+        QSize size = reader.size();
+        if (reader.transformation().testFlag(QImageIOHandler::TransformationRotate90))
+            size.transpose();
+        item.width  = size.width();
+        item.height = size.height();
+    }
+
+    const QString labelPath = QDir(m_labelDir).filePath(QFileInfo(item.name).completeBaseName() + ".txt");
+    if (m_store) {
+        item.hasLabel = m_store->read(labelPath, item.labels);
+        item.bytes    = std::max<qint64>(0, m_store->textSize(labelPath));
+        item.boxes    = item.labels.size();
+        return item;
+    }
+
+    QFile f(labelPath);
+    if (!f.open(QIODevice::ReadOnly))
+        return item;
+    const QByteArray text = f.readAll();
+    QVector<YoloLabelError> errors;
+    parseYoloLabels(text.constData(), text.size(), item.labels, &errors);
+    item.hasLabel  = true;
+    item.bytes     = text.size();
+    item.malformed = errors.size();
+    item.boxes     = item.labels.size();
+    return item;
+}
+
+bool LabelExporter::writeVoc(const Item &item, const QString &outDir) const
+{
+    QByteArray xml;
+    xml.reserve(512 + item.labels.size() * 256);
+    xml += "<annotation>\n";
+    xml += "  <folder>" + QFileInfo(m_imageDir).fileName().toHtmlEscaped().toUtf8() + "</folder>\n";
+    xml += "  <filename>" + item.name.toHtmlEscaped().toUtf8() + "</filename>\n";
+    xml += "  <size>\n";
+    xml += "    <width>" + QByteArray::number(item.width) + "</width>\n";
+    xml += "    <height>" + QByteArray::number(item.height) + "</height>\n";
+    xml += "    <depth>3</depth>\n";
+    xml += "  </size>\n";
+    xml += "  <segmented>0</segmented>\n";
+
+    for (const YoloLabel &l : item.labels) {
+        // VOC pixels are 1-based, max inclusive
+        const double x0 = (l.cx - l.w / 2.0) * item.width;
+        const double y0 = (l.cy - l.h / 2.0) * item.height;
+        const int xmin = std::clamp(int(std::lround(x0)) + 1, 1, std::max(1, item.width));
+        const int ymin = std::clamp(int(std::lround(y0)) + 1, 1, std::max(1, item.height));
+        const int xmax = std::clamp(int(std::lround(x0 + l.w * item.width)), xmin, std::max(1, item.width));
+        const int ymax = std::clamp(int(std::lround(y0 + l.h * item.height)), ymin, std::max(1, item.height));
+        const QString name = l.cls < m_classNames.size() ? m_classNames.at(l.cls) : QString::number(l.cls);
+
+        xml += "  <object>\n";
+        xml += "    <name>" + name.toHtmlEscaped().toUtf8() + "</name>\n";
+        xml += "    <pose>Unspecified</pose>\n";
+        xml += "    <truncated>0</truncated>\n";
+        xml += "    <difficult>0</difficult>\n";
+        if (l.conf < 1.0)
+            xml += "    <confidence>" + QByteArray::number(l.conf, 'f', 6) + "</confidence>\n";
+        xml += "    <bndbox>\n";
+        xml += "      <xmin>" + QByteArray::number(xmin) + "</xmin>\n";
+        xml += "      <ymin>" + QByteArray::number(ymin) + "</ymin>\n";
+        xml += "      <xmax>" + QByteArray::number(xmax) + "</xmax>\n";
+        xml += "      <ymax>" + QByteArray::number(ymax) + "</ymax>\n";
+        xml += "    </bndbox>\n";
+        xml += "  </object>\n";
+    }
+    xml += "</annotation>\n";
+
+    QFile f(QDir(outDir).filePath(QFileInfo(item.name).completeBaseName() + ".xml"));
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate) || f.write(xml) != xml.size()) {
+        qWarning() << "[export] cannot write" << f.fileName() << ":" << f.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool LabelExporter::run(Format format, const QString &out, const std::atomic_bool &cancel,
+                        const std::function<void(qint64, qint64)> &progress, QString *error)
+{
+    auto fail = [error](const QString &why) {
+        qWarning() << "[export]" << why;
+        if (error) *error = why;
+        return false;
+    };
+
+    m_stats = Stats();
+    QElapsedTimer timer;
+    timer.start();
+    const int total = m_images.size();
+
+    // COCO: images stream straight into the output, annotations into a
+    // temporary file that is appended once the image list is complete.
+    QSaveFile json(out);
+    QTemporaryFile annotations;
+    bool firstImage = true, firstAnnotation = true;
+    qint64 annotationId = 0;
+    if (format == Coco) {
+        if (!json.open(QIODevice::WriteOnly))
+            return fail(QObject::tr("cannot write %1: %2").arg(out, json.errorString()));
+        if (!annotations.open())
+            return fail(QObject::tr("cannot create a temporary file: %1").arg(annotations.errorString()));
+
+        QByteArray head = "{\"info\":{\"description\":\"Exported by YoloLabel\",\"date_created\":"
+                          + jsonString(QDateTime::currentDateTime().toString(Qt::ISODate))
+                          + "},\n\"licenses\":[],\n\"categories\":[";
+        // COCO reserves 0, so category ids are class ids + 1
+        for (int c = 0; c < m_classNames.size(); ++c) {
+            if (c) head += ',';
+            head += "\n{\"id\":" + QByteArray::number(c + 1) + ",\"name\":" + jsonString(m_classNames.at(c))
+                    + ",\"supercategory\":\"none\"}";
+        }
+        head += "],\n\"images\":[";
+        json.write(head);
+    } else if (!QDir().mkpath(out)) {
+        return fail(QObject::tr("cannot create %1").arg(out));
+    }
+
+    QVector<int> indices;
+    indices.reserve(kChunk);
+    int vocFailures = 0;
+    for (int first = 0; first < total; first += kChunk) {
+        if (cancel.load())
+            break;
+
+        indices.clear();
+        for (int i = first; i < std::min(total, first + kChunk); ++i)
+            indices.push_back(i);
+
+        const QVector<Item> items = format == Voc
+            ? QtConcurrent::blockingMapped<QVector<Item>>(indices, [this, &out](int i) {
+                  Item item = load(i);
+                  item.ok = writeVoc(item, out);
+                  item.labels.clear();   // done with them
+                  return item;
+              })
+            : QtConcurrent::blockingMapped<QVector<Item>>(indices, [this](int i) { return load(i); });
+
+        QByteArray imgBuf, annBuf;
+        for (int k = 0; k < items.size(); ++k) {
+            const Item &item = items.at(k);
+            const int imageId = indices.at(k) + 1;
+            ++m_stats.images;
+            m_stats.labeled   += item.hasLabel ? 1 : 0;
+            m_stats.boxes     += item.boxes;
+            m_stats.malformed += item.malformed;
+            m_stats.bytesRead += item.bytes;
+            vocFailures       += item.ok ? 0 : 1;
+            if (format != Coco)
+                continue;
+
+            if (!firstImage) imgBuf += ',';
+            firstImage = false;
+            imgBuf += "\n{\"id\":" + QByteArray::number(imageId) + ",\"file_name\":" + jsonString(item.name)
+                      + ",\"width\":" + QByteArray::number(item.width)
+                      + ",\"height\":" + QByteArray::number(item.height) + '}';
+
+            for (const YoloLabel &l : item.labels) {
+                const double w = l.w * item.width, h = l.h * item.height;
+                const double x = l.cx * item.width - w / 2.0, y = l.cy * item.height - h / 2.0;
+                if (!firstAnnotation) annBuf += ',';
+                firstAnnotation = false;
+                annBuf += "\n{\"id\":" + QByteArray::number(++annotationId)
+                          + ",\"image_id\":" + QByteArray::number(imageId)
+                          + ",\"category_id\":" + QByteArray::number(l.cls + 1)
+                          + ",\"bbox\":[" + num(x) + ',' + num(y) + ',' + num(w) + ',' + num(h) + ']'
+                          + ",\"area\":" + num(w * h) + ",\"iscrowd\":0";
+                if (l.conf < 1.0)
+                    annBuf += ",\"score\":" + QByteArray::number(l.conf, 'f', 6);
+                annBuf += '}';
+            }
+        }
+        if (format == Coco) {
+            if (json.write(imgBuf) != imgBuf.size()) {
+                json.cancelWriting();
+                return fail(QObject::tr("cannot write %1: %2").arg(out, json.errorString()));
+            }
+            if (annotations.write(annBuf) != annBuf.size()) {
+                json.cancelWriting();
+                return fail(QObject::tr("cannot write a temporary file: %1").arg(annotations.errorString()));
+            }
+        }
+
+        if (progress)
+            progress(m_stats.images, total);
+    }
+
+    if (cancel.load()) {
+        json.cancelWriting();
+        return fail(QObject::tr("export cancelled"));
+    }
+
+    if (format == Coco) {
+        json.write("],\n\"annotations\":[");
+        // A short read would still close the array and look like valid JSON
+        qint64 copied = 0;
+        bool writeFailed = false;
+        if (annotations.flush() && annotations.seek(0)) {
+            QByteArray block;
+            while (!(block = annotations.read(1 << 20)).isEmpty()) {
+                if (json.write(block) != block.size()) {
+                    writeFailed = true;
+                    break;
+                }
+                copied += block.size();
+            }
+        }
+        if (writeFailed) {
+            json.cancelWriting();
+            return fail(QObject::tr("cannot write %1: %2").arg(out, json.errorString()));
+        }
+        if (copied != annotations.size()) {
+            json.cancelWriting();
+            return fail(QObject::tr("cannot read back a temporary file: %1").arg(annotations.errorString()));
+        }
+        json.write("]}\n");
+        if (!json.commit())
+            return fail(QObject::tr("cannot write %1: %2").arg(out, json.errorString()));
+    }
+
+    m_stats.msecs = std::max<qint64>(1, timer.elapsed());
+    qDebug().noquote() << QString("[export] %1: %2 images (%3 labeled), %4 boxes in %5 s, %6 images/s, %7 boxes/s, %8 MB/s read")
+                              .arg(format == Coco ? "COCO" : "VOC")
+                              .arg(m_stats.images).arg(m_stats.labeled).arg(m_stats.boxes)
+                              .arg(m_stats.msecs / 1000.0, 0, 'f', 2)
+                              .arg(m_stats.imagesPerSec(), 0, 'f', 0)
+                              .arg(m_stats.boxesPerSec(), 0, 'f', 0)
+                              .arg(m_stats.bytesRead / 1048576.0 / (m_stats.msecs / 1000.0), 0, 'f', 1);
+    if (m_stats.malformed)
+        qWarning() << "[export] skipped" << m_stats.malformed << "malformed label lines";
+    if (vocFailures)
+        return fail(QObject::tr("%1 VOC files could not be written").arg(vocFailures));
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef LABEL_EXPORTER_H
+#define LABEL_EXPORTER_H
+
+#include <QString>
+#include <QStringList>
+
+#include "image_list.h"
+
+#include <atomic>
+#include <functional>
+
+class AnnotationStore;
+
+// Converts a dataset's YOLO labels to COCO JSON (one file) or Pascal VOC
+// (one XML per image). Labels are read and parsed in parallel a chunk of
+// images at a time and written out in order as each chunk completes, so
+// memory doesn't grow with the dataset. Boxes are read the way label_img
+// reads them: centre to top-left, optional 6th confidence column.
+class LabelExporter
+{
+public:
+    enum Format { Coco, Voc };
+
+    struct Stats {
+        qint64 images = 0;
+        qint64 labeled = 0;      // images with a label file
+        qint64 boxes = 0;
+        qint64 malformed = 0;    // skipped label lines
+        qint64 bytesRead = 0;    // label text
+        qint64 msecs = 0;
+        double imagesPerSec() const { return msecs > 0 ? images * 1000.0 / msecs : 0; }
+        double boxesPerSec() const  { return msecs > 0 ? boxes  * 1000.0 / msecs : 0; }
+    };
+
+    LabelExporter(const QString &imageDir, const ImageList &images,
+                  const QString &labelDir, const QStringList &classNames);
+
+    // Read labels from the single-file store instead of .txt files.
+    void setStore(const AnnotationStore *store) { m_store = store; }
+
+    // `out` is the .json file for COCO, the output directory for VOC. Blocks;
+    // meant for a worker thread. `progress` is called from that thread.
+    bool run(Format format, const QString &out, const std::atomic_bool &cancel,
+             const std::function<void(qint64 done, qint64 total)> &progress = {},
+             QString *error = nullptr);
+
+    const Stats &stats() const { return m_stats; }
+
+private:
+    struct Item;
+
+    Item load(int index) const;
+    bool writeVoc(const Item &item, const QString &outDir) const;
+
+    QString         m_imageDir;
+    ImageList       m_images;      // shares the index's data
+    QString         m_labelDir;
+    QStringList     m_classNames;
+    const AnnotationStore *m_store = nullptr;
+    Stats           m_stats;
+};
+
+#endif // LABEL_EXPORTER_H
@@ -1,17 +1,22 @@
 #include "label_img.h"
 #include <QPainter>
 #include <QImageReader>
+#include <QFileInfo>
 #include <cmath>
 #include <algorithm>
-#include <sstream>
 #include <QCursor>
 #include <QtGlobal>
 #include <utility>
 #include <QGestureEvent>
 #include <QPinchGesture>
 #include <QGesture>
+#include <QtConcurrent>
+#include <QGuiApplication>
+#include <QScreen>
 
-//#include <omp.h>
+#include "image_pyramid.h"
+#include "gamma_lut.h"
+#include "edit_journal.h"
 
 #include <QSet>
 
@@ -81,6 +86,21 @@ label_img::label_img(QWidget *parent)
 {
     setAttribute(Qt::WA_AcceptTouchEvents);
     grabGesture(Qt::PinchGesture);
+
+    connect(&m_pyramidWatcher, &QFutureWatcher<QVector<QImage>>::finished, this, [this]() {
+        m_pyramid = m_pyramidWatcher.result();
+    });
+    connect(&m_fullResWatcher, &QFutureWatcher<QImage>::finished, this, [this]() {
+        if (!m_fullResPending)
+            return;
+        m_fullResPending = false;
+        const QImage full = m_fullResWatcher.result();
+        if (full.isNull())
+            return;
+        adoptFullResolution(full);
+        showImage();
+    });
+
     init();
 }
 
@@ -127,6 +147,7 @@ void label_img::mouseMoveEvent(QMouseEvent *ev)
         // Now create the relative QRectF
         QRectF rel = getRelativeRectFromTwoPoints(relTopLeft, relBottomRight);
         m_objBoundingBoxes[m_dragIndex].box = rel;
+        m_labelsDirty = true;
         emit boxesChanged();
         showImage();
         return;
@@ -205,10 +226,13 @@ void label_img::mousePressEvent(QMouseEvent *ev)
             ob.box   = getRelativeRectFromTwoPoints(m_relative_mouse_pos_in_ui,
                                                     m_relatvie_mouse_pos_LBtnClicked_in_ui);
 
-            bool tooSmallW = ob.box.width()  * m_inputImg.width()  < 4;
-            bool tooSmallH = ob.box.height() * m_inputImg.height() < 4;
-            if (!tooSmallW && !tooSmallH)
+            bool tooSmallW = ob.box.width()  * m_fullSize.width()  < 4;
+            bool tooSmallH = ob.box.height() * m_fullSize.height() < 4;
+            if (!tooSmallW && !tooSmallH) {
                 m_objBoundingBoxes.push_back(ob);
+                m_labelsDirty = true;
+                if (m_journal) m_journal->added(toYoloLabel(ob));
+            }
 
             m_bLabelingStarted = false;
             if (m_labelingGrab) { releaseMouse(); m_labelingGrab = false; }
@@ -283,6 +307,8 @@ void label_img::mouseReleaseEvent(QMouseEvent *ev)
         QPointF relTL = cvtAbsoluteToRelativePoint(r.topLeft());
         QPointF relBR = cvtAbsoluteToRelativePoint(r.bottomRight());
         m_objBoundingBoxes[m_dragIndex].box = getRelativeRectFromTwoPoints(relTL, relBR);
+        m_labelsDirty = true;
+        if (m_journal) m_journal->changed(m_dragIndex, toYoloLabel(m_objBoundingBoxes[m_dragIndex]));
 
         m_dragging = false;
         m_dragIndex = -1;
@@ -318,6 +344,7 @@ void label_img::init()
     m_cropMode                      = false;
     m_croppingActive                = false;
     m_imageDirty                    = false;
+    m_labelsDirty                   = false;
 
     resetView();
 
@@ -502,13 +529,57 @@ void label_img::setMousePosition(int x, int y)
     m_relative_mouse_pos_in_ui = cvtAbsoluteToRelativePoint(QPoint(x, y));
 }
 
-void label_img::openImage(const QString &qstrImg, bool &ret)
+QSize label_img::displayDecodeSize()
 {
+    // GUI thread only. Enough pixels to fill the screen at fit-to-window zoom.
+    QScreen *screen = QGuiApplication::primaryScreen();
+    if (!screen)
+        return QSize();
+    return screen->size() * screen->devicePixelRatio();
+}
+
+DecodedImage label_img::decodeImage(const QString &qstrImg, const QSize &maxSize)
+{
+    // Safe to call from worker threads (used by the prefetcher)
+    DecodedImage d;
+    d.path = qstrImg;
+
     QImageReader imgReader(qstrImg);
     imgReader.setAutoTransform(true);
+
+    QSize stored = imgReader.size();   // header only, before EXIF rotation
+    const bool rotated = imgReader.transformation().testFlag(QImageIOHandler::TransformationRotate90);
+    d.fullSize = rotated ? stored.transposed() : stored;
+
+    // Only where the decoder can do it natively (JPEG DCT scaling); for other
+    // formats a scaled read would decode in full and then resample anyway.
+    if (maxSize.isValid() && stored.isValid() &&
+        imgReader.supportsOption(QImageIOHandler::ScaledSize)) {
+        const QSize bound = rotated ? maxSize.transposed() : maxSize;
+        if (stored.width() > bound.width() || stored.height() > bound.height())
+            imgReader.setScaledSize(stored.scaled(bound, Qt::KeepAspectRatio));
+    }
+
     QImage img = imgReader.read();
+    if (img.isNull())
+        return d;
+    d.image = img.convertToFormat(QImage::Format_RGB888);
+    if (!d.fullSize.isValid() || !d.isReduced())
+        d.fullSize = d.image.size();
+    return d;
+}
+
+void label_img::openImage(const QString &qstrImg, bool &ret)
+{
+    setImage(decodeImage(qstrImg, displayDecodeSize()), ret);
+}
+
+void label_img::setImage(const DecodedImage &decoded, bool &ret)
+{
+    invalidateBaseLayer();
+    m_fullResPending = false;   // a late full-res result belongs to the previous image
 
-    if(img.isNull())
+    if(decoded.isNull())
     {
         m_inputImg = QImage();
         ret = false;
@@ -516,20 +587,22 @@ void label_img::openImage(const QString &qstrImg, bool &ret)
     else
     {
         ret = true;
+        clear();   // drop the placeholder help text; paintEvent draws from here on
 
         m_objBoundingBoxes.clear();
 
-        m_inputImg          = img.copy();
-        m_inputImg          = m_inputImg.convertToFormat(QImage::Format_RGB888);
-        m_resized_inputImg  = m_inputImg.scaled(this->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation)
-
-                .convertToFormat(QImage::Format_RGB888);
+        m_inputImg          = decoded.image.convertToFormat(QImage::Format_RGB888);
+        m_imagePath         = decoded.path;
+        m_fullSize          = decoded.fullSize;
+        m_fullResLoaded     = !decoded.isReduced();
 
         m_bLabelingStarted  = false;
         m_cropMode          = false;
         m_croppingActive    = false;
         m_imageDirty        = false;
+        m_labelsDirty       = false;
 
+        startPyramidBuild();
         resetView();
 
         QPoint mousePosInUi     = this->mapFromGlobal(QCursor::pos());
@@ -562,24 +635,112 @@ void label_img::showImage()
         std::max(1, int(std::round(m_inputImg.height() * scale)))
     );
 
-    QImage scaled = m_inputImg
-        .scaled(scaledSz, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
-        .convertToFormat(QImage::Format_RGB888);
-
-    QPointF topLeftF = computeTopLeft(canvasSz, scaled.size());
+    QPointF topLeftF = computeTopLeft(canvasSz, scaledSz);
     QPoint topLeft(qRound(topLeftF.x()), qRound(topLeftF.y()));
 
-    m_imgDrawRect = QRect(topLeft, scaled.size());
+    m_imgDrawRect = QRect(topLeft, scaledSz);
+
+    // Zoomed past what the reduced display decode holds: fetch the real pixels
+    if (!m_fullResLoaded && scaledSz.width() > m_inputImg.width())
+        requestFullResolution();
+
+    updateBaseLayer(scaledSz, topLeft);
+    update();
+}
+
+void label_img::updateBaseLayer(const QSize &scaledSz, const QPoint &topLeft)
+{
+    const QSize canvasSz = this->size();
+    const QRect fullRect(QPoint(0, 0), scaledSz);
+
+    // Part of the scaled image that lands on the canvas
+    QRect visible = QRect(-topLeft, canvasSz).intersected(fullRect);
+    if (visible.isEmpty())
+        visible = fullRect;
+
+    if (!m_baseLayer.isNull() && m_baseScaledSize == scaledSz && m_baseRect.contains(visible))
+        return;
+
+    // Scaling the whole image only pays off while it is about canvas-sized;
+    // past that, resample just the source pixels behind the viewport.
+    const bool viewportOnly = qint64(scaledSz.width()) * scaledSz.height()
+                              > 2 * qint64(canvasSz.width()) * canvasSz.height();
+
+    // Resample from the coarsest pyramid level that still has enough pixels
+    const QImage &src = sourceForScale(scaledSz.width() / double(m_inputImg.width()));
+
+    QImage scaled;
+    QRect layerRect = fullRect;
+    if (!viewportOnly) {
+        scaled = src.scaled(scaledSz, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    } else {
+        // A quarter canvas of margin on each side so short pans reuse the layer
+        const QRect want = visible.adjusted(-canvasSz.width() / 4, -canvasSz.height() / 4,
+                                            canvasSz.width() / 4,  canvasSz.height() / 4)
+                                  .intersected(fullRect);
+
+        const double sx = scaledSz.width()  / double(src.width());
+        const double sy = scaledSz.height() / double(src.height());
+
+        // Whole source pixels covering `want`
+        const int x0 = std::clamp(int(std::floor(want.left() / sx)),        0, src.width()  - 1);
+        const int y0 = std::clamp(int(std::floor(want.top()  / sy)),        0, src.height() - 1);
+        const int x1 = std::clamp(int(std::ceil((want.right()  + 1) / sx)), x0 + 1, src.width());
+        const int y1 = std::clamp(int(std::ceil((want.bottom() + 1) / sy)), y0 + 1, src.height());
+
+        layerRect = QRect(QPoint(int(std::round(x0 * sx)), int(std::round(y0 * sy))),
+                          QPoint(int(std::round(x1 * sx)) - 1, int(std::round(y1 * sy)) - 1));
+
+        scaled = src.copy(QRect(QPoint(x0, y0), QPoint(x1 - 1, y1 - 1)))
+                     .scaled(layerRect.size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    m_baseScaled     = scaled.convertToFormat(QImage::Format_RGB888);
+    m_baseRect       = layerRect;
+    m_baseScaledSize = scaledSz;
+    applyGammaToBaseLayer();
+}
+
+void label_img::applyGammaToBaseLayer()
+{
+    // Gamma on the scaled image only (not on the letterbox background)
+    QImage shown = m_baseScaled;
+    gammaTransform(shown);
+    m_baseLayer = QPixmap::fromImage(shown);
+}
+
+const QImage &label_img::sourceForScale(double scale) const
+{
+    // Levels halve in size; a level is usable while it is at least `scale` x base
+    const QImage *best = &m_inputImg;
+    for (const QImage &level : m_pyramid) {
+        if (level.width() < m_inputImg.width() * scale)
+            break;
+        best = &level;
+    }
+    return *best;
+}
 
-    // Apply gamma on the scaled image only (not on the letterbox background)
-    gammaTransform(scaled);
+void label_img::startPyramidBuild()
+{
+    m_pyramid.clear();
+    if (m_inputImg.isNull())
+        return;
 
-    // Compose a full-size canvas so our overlay math stays in widget coords
-    QImage canvas(canvasSz, QImage::Format_RGB888);
-    canvas.fill(QColor(24, 24, 24)); // letterbox background
+    // Replacing the future also drops any result still pending for the previous image
+    const QImage base = m_inputImg;
+    m_pyramidWatcher.setFuture(QtConcurrent::run([base]() { return buildImagePyramid(base); }));
+}
 
-    QPainter painter(&canvas);
-    painter.drawImage(topLeft, scaled);
+void label_img::paintEvent(QPaintEvent *event)
+{
+    if (m_inputImg.isNull() || m_baseLayer.isNull()) {
+        QLabel::paintEvent(event);
+        return;
+    }
+
+    QPainter painter(this);
+    painter.fillRect(rect(), QColor(24, 24, 24)); // letterbox background
+    painter.drawPixmap(m_imgDrawRect.topLeft() + m_baseRect.topLeft(), m_baseLayer);
 
     // UI styling
     QFont font = painter.font();
@@ -598,7 +759,7 @@ void label_img::showImage()
     if (m_bVisualizeClassName)
         drawObjectLabels(painter, penThick, fontSize, xMargin, yMargin);
 
-    this->setPixmap(QPixmap::fromImage(canvas));
+    drawFrame(&painter);
 }
 
 double label_img::fitScaleForCanvas(const QSize &canvas) const
@@ -663,38 +824,70 @@ QPointF label_img::computeTopLeft(const QSize &canvasSz, const QSize &scaledSz)
 
 void label_img::loadLabelData(const QString& labelFilePath)
 {
-    std::ifstream inputFile(qPrintable(labelFilePath));
-    if (inputFile.is_open())
-    {
-        std::string line;
-        while (std::getline(inputFile, line))
-        {
-            if (line.empty()) continue;
-            std::istringstream iss(line);
+    QVector<YoloLabel> labels;
+    readYoloLabelFile(labelFilePath, labels);   // malformed lines are logged and skipped
+    appendLabels(labels);
 
-            double cls, midX, midY, width, height, conf;
-            if (!(iss >> cls >> midX >> midY >> width >> height))
-                continue; // malformed line
+    // No file yet: the (possibly empty) set still needs writing once
+    m_labelsDirty = !QFileInfo::exists(labelFilePath);
+    emit boxesChanged();
+}
 
-            ObjectLabelingBox objBox;
-            objBox.label = static_cast<int>(cls);
+void label_img::setLabels(const QVector<YoloLabel> &labels, bool stored)
+{
+    m_objBoundingBoxes.clear();
+    appendLabels(labels);
+    m_labelsDirty = !stored;
+    emit boxesChanged();
+}
 
-            // optional confidence (6th value)
-            if (iss >> conf) objBox.confidence = conf; // present
-            else             objBox.confidence = 1.0;  // default
+void label_img::appendLabels(const QVector<YoloLabel> &labels)
+{
+    m_objBoundingBoxes.reserve(m_objBoundingBoxes.size() + labels.size());
+    for (const YoloLabel &l : labels)
+    {
+        ObjectLabelingBox objBox;
+        objBox.label      = l.cls;
+        objBox.confidence = l.conf;
 
-            // convert center->top-left (normalized coords)
-            double leftX = midX - width / 2.0;
-            double topY  = midY - height / 2.0;
+        // convert center->top-left (normalized coords)
+        objBox.box.setX(l.cx - l.w / 2.0);
+        objBox.box.setY(l.cy - l.h / 2.0);
+        objBox.box.setWidth(l.w);
+        objBox.box.setHeight(l.h);
 
-            objBox.box.setX(leftX);
-            objBox.box.setY(topY);
-            objBox.box.setWidth(width);
-            objBox.box.setHeight(height);
+        m_objBoundingBoxes.push_back(objBox);
+    }
+}
 
-            m_objBoundingBoxes.push_back(objBox);
-        }
+YoloLabel label_img::toYoloLabel(const ObjectLabelingBox &ob)
+{
+    YoloLabel l;
+    l.cls  = ob.label;
+    l.cx   = ob.box.x() + ob.box.width() / 2.;
+    l.cy   = ob.box.y() + ob.box.height() / 2.;
+    l.w    = ob.box.width();
+    l.h    = ob.box.height();
+    l.conf = ob.confidence;
+    return l;
+}
+
+QVector<YoloLabel> label_img::labels() const
+{
+    QVector<YoloLabel> out;
+    out.reserve(m_objBoundingBoxes.size());
+    for (const ObjectLabelingBox &ob : m_objBoundingBoxes)
+        out.push_back(toYoloLabel(ob));
+    return out;
+}
+
+void label_img::clearBoxes()
+{
+    if (!m_objBoundingBoxes.isEmpty()) {
+        m_labelsDirty = true;
+        if (m_journal) m_journal->replaced({});
     }
+    m_objBoundingBoxes.clear();
     emit boxesChanged();
 }
 
@@ -716,9 +909,53 @@ bool label_img::isOpened()
 
 QImage label_img::crop(QRect rect)
 {
+    ensureFullResolution();
     return m_inputImg.copy(rect);
 }
 
+bool label_img::ensureFullResolution()
+{
+    if (m_inputImg.isNull())
+        return false;
+    if (m_fullResLoaded)
+        return true;
+
+    // Reuse a background decode that is already running instead of starting another
+    QImage full;
+    if (m_fullResPending) {
+        m_fullResPending = false;
+        m_fullResWatcher.waitForFinished();
+        full = m_fullResWatcher.result();
+    }
+    if (full.isNull())
+        full = decodeImage(m_imagePath).image;
+    if (full.isNull())
+        return false;
+
+    adoptFullResolution(full);
+    return true;
+}
+
+void label_img::requestFullResolution()
+{
+    if (m_fullResLoaded || m_fullResPending || m_imagePath.isEmpty())
+        return;
+
+    m_fullResPending = true;
+    const QString path = m_imagePath;
+    m_fullResWatcher.setFuture(QtConcurrent::run([path]() { return decodeImage(path).image; }));
+}
+
+void label_img::adoptFullResolution(const QImage &full)
+{
+    // Geometry is relative, so swapping in more pixels keeps zoom, pan and boxes
+    m_inputImg      = full.convertToFormat(QImage::Format_RGB888);
+    m_fullSize      = m_inputImg.size();
+    m_fullResLoaded = true;
+    invalidateBaseLayer();
+    startPyramidBuild();
+}
+
 void label_img::beginCropSelection()
 {
     if (m_inputImg.isNull())
@@ -749,6 +986,10 @@ bool label_img::applyCrop(const QRectF &relRect)
     if (m_inputImg.isNull())
         return false;
 
+    // Crops are saved back to the file, so they must come from the full image
+    if (!ensureFullResolution())
+        return false;
+
     QRectF normalized = relRect.normalized();
     QRect cropRect = cvtRelativeToAbsoluteRectInImage(normalized);
     if (cropRect.width() < 1 || cropRect.height() < 1)
@@ -797,8 +1038,12 @@ bool label_img::applyCrop(const QRectF &relRect)
     }
 
     m_objBoundingBoxes = newBoxes;
+    m_labelsDirty = true;
+    if (m_journal) m_journal->replaced(labels());
     m_inputImg = m_inputImg.copy(cropRect);
-    m_resized_inputImg = m_inputImg;
+    m_fullSize = m_inputImg.size();
+    invalidateBaseLayer();
+    startPyramidBuild();
     m_imageDirty = true;
     m_focusedIndex = -1;
 
@@ -939,8 +1184,8 @@ void label_img::drawObjectLabels(QPainter& painter, int thickWidth, int fontPixe
             : QString("Class %1").arg(ob.label);
 
         QString text = base;
-        if (i < m_confForThisImage.size())
-            text = QString("%1 (%2)").arg(base).arg(m_confForThisImage[i], 0, 'f', 2);
+        if (ob.confidence < 1.0)   // from the model, not drawn by hand
+            text = QString("%1 (%2)").arg(base).arg(ob.confidence, 0, 'f', 2);
 
         // If multiple classes overlap, show them together: "A • B • C"
         if (m_showOverlapHints && !overlaps[i].isEmpty()) {
@@ -987,27 +1232,9 @@ void label_img::drawObjectLabels(QPainter& painter, int thickWidth, int fontPixe
 
 void label_img::gammaTransform(QImage &image)
 {
-    uchar* bits = image.bits();
-
-    int h = image.height();
-    int w = image.width();
-
-    //#pragma omp parallel for collapse(2)
-    for(int y = 0 ; y < h; ++y)
-    {
-        for(int x = 0; x < w; ++x)
-        {
-            int index_pixel = (y*w+x)*3;
-
-            unsigned char r = bits[index_pixel + 0];
-            unsigned char g = bits[index_pixel + 1];
-            unsigned char b = bits[index_pixel + 2];
-
-            bits[index_pixel + 0] = m_gammatransform_lut[r];
-            bits[index_pixel + 1] = m_gammatransform_lut[g];
-            bits[index_pixel + 2] = m_gammatransform_lut[b];
-        }
-    }
+    if (m_gammaIsIdentity)
+        return;
+    applyLut8(image, m_gammatransform_lut);
 }
 
 void label_img::removeFocusedObjectBox(QPointF point)
@@ -1033,6 +1260,8 @@ void label_img::removeFocusedObjectBox(QPointF point)
     if(removeBoxIdx != -1)
     {
         m_objBoundingBoxes.remove(removeBoxIdx);
+        m_labelsDirty = true;
+        if (m_journal) m_journal->removed(removeBoxIdx);
         emit boxesChanged();
     }
 
@@ -1146,9 +1375,18 @@ void label_img::setContrastGamma(float gamma)
 {
     for(int i=0; i < 256; i++)
     {
-        int s = (int)(pow((float)i/255., gamma) * 255.);
+        int s = (int)std::lround(pow((float)i/255., gamma) * 255.);
         s = std::clamp(s, 0, 255);
         m_gammatransform_lut[i] = (unsigned char)s;
     }
+    m_gammaIsIdentity = isIdentityLut(m_gammatransform_lut);
+
+    // Only the table changed: re-map the cached scaled pixels instead of
+    // resampling, so dragging the contrast slider stays cheap on big frames.
+    if (!m_baseScaled.isNull()) {
+        applyGammaToBaseLayer();
+        update();
+        return;
+    }
     showImage();
 }
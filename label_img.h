@@ -7,6 +7,12 @@
 #include <QMouseEvent>
 #include <QWheelEvent>
 #include <QResizeEvent>
+#include <QPaintEvent>
+#include <QPixmap>
+#include <QFutureWatcher>
+
+#include "decoded_image.h"
+#include "yolo_label_io.h"
 #include <QEvent>
 #include <iostream>
 #include <fstream>
@@ -21,6 +27,7 @@
 
 class QPainter;
 class QPinchGesture;
+class EditJournal;
 
 struct ObjectLabelingBox
 {
@@ -42,6 +49,7 @@ public:
     void mouseReleaseEvent(QMouseEvent *ev) override;
     void wheelEvent(QWheelEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
     bool event(QEvent *event) override;
 
 
@@ -62,7 +70,6 @@ public:
     static  QColor BOX_COLORS[10];
 
     QVector<ObjectLabelingBox> m_objBoundingBoxes;
-    QVector<double> m_confForThisImage; // one-time confidences for current image
 
     // highlight stacked boxes + avoid label collisions
     bool   m_avoidLabelOverlap  = true;   // nudge label texts to free space
@@ -72,15 +79,32 @@ public:
 
     void init();
     void openImage(const QString &, bool& ret);
+    void setImage(const DecodedImage &decoded, bool& ret);
+
+    // Decodes with EXIF orientation applied. A valid `maxSize` asks for a
+    // reduced decode (JPEG DCT scaling) when the image is larger than that.
+    static DecodedImage decodeImage(const QString &, const QSize &maxSize = QSize());
+    static QSize displayDecodeSize();
+    bool ensureFullResolution();
     void showImage();
 
     void loadLabelData(const QString &);
+    void setLabels(const QVector<YoloLabel> &, bool stored = true);   // replaces the boxes, as if loaded
+    QVector<YoloLabel> labels() const;            // boxes in label-file form (centre, normalized)
+
+    // Boxes differ from the label file (or there is no file yet)
+    bool hasUnsavedLabels() const { return m_labelsDirty; }
+    void setLabelsSaved() { m_labelsDirty = false; }
+    void clearBoxes();
+
+    void setEditJournal(EditJournal *journal) { m_journal = journal; }
 
     void setFocusObjectLabel(int);
     void setFocusObjectName(QString);
     void setContrastGamma(float);
 
     bool isOpened();
+    const QImage &image() const { return m_inputImg; }
     QImage crop(QRect);
 
     void beginCropSelection();
@@ -113,8 +137,21 @@ private:
     double m_aspectRatioWidth;
     double m_aspectRatioHeight;
 
-    QImage m_inputImg;
-    QImage m_resized_inputImg;
+    void appendLabels(const QVector<YoloLabel> &);
+    static YoloLabel toYoloLabel(const ObjectLabelingBox &);
+
+    EditJournal *m_journal = nullptr;   // told about every committed box edit
+
+    // m_inputImg may be a reduced display decode until zooming in or cropping
+    // needs the real pixels; m_fullSize is always the full-resolution size.
+    QImage  m_inputImg;
+    QString m_imagePath;
+    QSize   m_fullSize;
+    bool    m_fullResLoaded = true;
+    bool    m_fullResPending = false;
+    QFutureWatcher<QImage> m_fullResWatcher;
+    void requestFullResolution();
+    void adoptFullResolution(const QImage &full);
 
     QPointF m_relative_mouse_pos_in_ui;
     QPointF m_relatvie_mouse_pos_LBtnClicked_in_ui;
@@ -125,6 +162,27 @@ private:
     QPoint m_tempFirstCorner;
 
     unsigned char m_gammatransform_lut[256];
+    bool m_gammaIsIdentity = true;
+
+    // Scaled + gamma-corrected image. Rebuilt only when the image or zoom/canvas
+    // size changes; cursor moves and pans just repaint the overlay, and a gamma
+    // change re-maps m_baseScaled (the same pixels before gamma) in place.
+    // When zoomed far in it only covers the visible part of the scaled image
+    // (plus a margin for panning): m_baseRect is that part in scaled coords.
+    QPixmap m_baseLayer;
+    QImage  m_baseScaled;
+    QRect   m_baseRect;
+    QSize   m_baseScaledSize;
+    void updateBaseLayer(const QSize &scaledSz, const QPoint &topLeft);
+    void applyGammaToBaseLayer();
+    void invalidateBaseLayer() { m_baseLayer = QPixmap(); m_baseScaled = QImage(); }
+
+    // 1/2, 1/4, ... downsamples of m_inputImg, built in the background after
+    // an image is set; empty until ready (level 0 is m_inputImg itself).
+    QVector<QImage> m_pyramid;
+    QFutureWatcher<QVector<QImage>> m_pyramidWatcher;
+    void startPyramidBuild();
+    const QImage &sourceForScale(double scale) const;
     QVector<QRgb> colorTable;
 
     void setMousePosition(int, int);
@@ -148,6 +206,7 @@ private:
     bool m_cropMode = false;
     bool m_croppingActive = false;
     bool m_imageDirty = false;
+    bool m_labelsDirty = false;
     double m_zoomFactor = 1.0;
     double m_minZoom = 0.2;
     double m_maxZoom = 8.0;
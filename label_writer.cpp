@@ -0,0 +1,132 @@
+#include "label_writer.h"
+#include "annotation_store.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+LabelWriter::LabelWriter(QObject *parent)
+    : QObject(parent)
+{
+    // One writer keeps saves of a file in order
+    m_pool.setMaxThreadCount(1);
+}
+
+LabelWriter::~LabelWriter()
+{
+    flush();
+    m_pool.waitForDone();
+}
+
+quint64 LabelWriter::save(const QString &labelPath, const QVector<YoloLabel> &labels)
+{
+    QMutexLocker lock(&m_mutex);
+    const bool queued = m_pending.contains(labelPath);
+    const quint64 seq = ++m_seq;
+    m_pending.insert(labelPath, Pending{labels, seq});
+    // Already queued (or being written, then drain() requeues it): coalesced
+    if (!queued)
+        m_queue.enqueue(labelPath);
+
+    if (!m_running) {
+        m_running = true;
+        m_pool.start([this]() { drain(); });
+    }
+    return seq;
+}
+
+bool LabelWriter::pending(const QString &labelPath, QVector<YoloLabel> &labels) const
+{
+    QMutexLocker lock(&m_mutex);
+    auto it = m_pending.constFind(labelPath);
+    if (it == m_pending.constEnd())
+        return false;
+    labels = it->labels;
+    return true;
+}
+
+void LabelWriter::discard(const QString &labelPath)
+{
+    QMutexLocker lock(&m_mutex);
+    m_queue.removeAll(labelPath);
+    m_pending.remove(labelPath);
+    while (m_writing == labelPath)
+        m_idle.wait(&m_mutex);
+}
+
+void LabelWriter::flush()
+{
+    QMutexLocker lock(&m_mutex);
+    while (m_running)
+        m_idle.wait(&m_mutex);
+}
+
+void LabelWriter::setStore(AnnotationStore *store)
+{
+    flush();
+    QMutexLocker lock(&m_mutex);
+    m_store = store;
+}
+
+void LabelWriter::drain()
+{
+    QMutexLocker lock(&m_mutex);
+    while (!m_queue.isEmpty()) {
+        const QString path = m_queue.dequeue();
+        auto it = m_pending.constFind(path);
+        if (it == m_pending.constEnd())
+            continue;
+        const Pending job = *it;
+        m_writing = path;
+
+        lock.unlock();
+        QString error;
+        const bool ok = writeFile(path, job.labels, error);
+        lock.relock();
+
+        m_writing.clear();
+        it = m_pending.constFind(path);
+        if (it != m_pending.constEnd()) {
+            if (it->seq == job.seq)
+                m_pending.remove(path);
+            else if (!m_queue.contains(path))
+                m_queue.enqueue(path);   // saved again while we were writing
+        }
+        m_idle.wakeAll();
+
+        if (ok) {
+            emit written(path, job.seq);
+        } else {
+            qWarning() << "[labels] failed to write" << path << ":" << error;
+            emit failed(path, error);
+        }
+    }
+    m_running = false;
+    m_idle.wakeAll();
+}
+
+bool LabelWriter::writeFile(const QString &path, const QVector<YoloLabel> &labels, QString &error)
+{
+    if (m_store && m_store->isOpen()) {
+        if (m_store->write(path, formatYoloLabels(labels)))
+            return true;
+        error = QObject::tr("label store write failed");
+        return false;
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly)) {
+        error = f.errorString();
+        return false;
+    }
+    f.write(formatYoloLabels(labels));
+    if (!f.commit()) {
+        error = f.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef LABEL_WRITER_H
+#define LABEL_WRITER_H
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QQueue>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "yolo_label_io.h"
+
+class AnnotationStore;
+
+// Writes label files on a background thread so navigation never waits on
+// the disk. Each file is written atomically (temp file + rename), and saves
+// of the same file that are still queued collapse into the latest one.
+// Until a save has reached the disk, pending() hands out its contents so a
+// quick return to the image doesn't read the old file.
+class LabelWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LabelWriter(QObject *parent = nullptr);
+    ~LabelWriter();   // flushes
+
+    // Returns the save's sequence number, as later reported by written()
+    quint64 save(const QString &labelPath, const QVector<YoloLabel> &labels);
+    bool pending(const QString &labelPath, QVector<YoloLabel> &labels) const;
+
+    // Drops a queued save (e.g. the image is being deleted) and waits out
+    // one that is already being written.
+    void discard(const QString &labelPath);
+
+    void flush();   // blocks until everything queued is on disk
+
+    // Saves go into `store` (if open) instead of .txt files. Flushes first.
+    void setStore(AnnotationStore *store);
+
+signals:
+    void written(const QString &labelPath, quint64 seq);   // that save and all before it
+    void failed(const QString &labelPath, const QString &error);
+
+private:
+    struct Pending {
+        QVector<YoloLabel> labels;
+        quint64 seq = 0;
+    };
+
+    void drain();
+    bool writeFile(const QString &path, const QVector<YoloLabel> &labels, QString &error);
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_idle;
+    QHash<QString, Pending> m_pending;   // stays until written, for pending()
+    QQueue<QString> m_queue;
+    QString m_writing;
+    quint64 m_seq = 0;
+    bool    m_running = false;
+    AnnotationStore *m_store = nullptr;   // only changed while idle
+    QThreadPool m_pool;
+};
+
+#endif // LABEL_WRITER_H
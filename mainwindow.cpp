@@ -1,20 +1,27 @@
 #include "mainwindow.h"
+#include "autolabel_worker.h"
+#include "autolabel_batch.h"
+#ifdef ONNX_INFERENCE
+#include "autolabel_lookahead.h"
+#endif
+#include "image_prefetcher.h"
+#include "image_cache.h"
+#include "image_dir_index.h"
+#include "label_writer.h"
+#include "edit_journal.h"
+#include "annotation_store.h"
+#include "label_exporter.h"
 #include <QProcess>
 #include <QFileInfo>
 #include <QTextStream>
 #include "ui_mainwindow.h"
-#include <QJsonDocument>
-#include <QJsonArray>
-#include <QJsonValue>
 #include <QFile>
-#include <QJsonObject>
 
 #include <QFileDialog>
 #include <QColorDialog>
 #include <QKeyEvent>
 #include <QDebug>
 #include <QShortcut>
-#include <QCollator>
 #include <iomanip>
 #include <cmath>
 #include <algorithm>
@@ -22,14 +29,18 @@
 #include <QDir>
 #include <QDateTime>
 #include <QCoreApplication>
+#include <QApplication>
 #include <QFileInfo>
 #include <QSignalBlocker>
+#include <QLabel>
 #include <QAbstractItemView>
+#include <QRegularExpression>
+#include <QtConcurrent>
+#include <tuple>
 static QString locateAutolabelScript();
 
 using std::cout;
 using std::endl;
-using std::ofstream;
 using std::ifstream;
 using std::string;
 
@@ -43,6 +54,25 @@ QString locateAutolabelScript() {
     return {};
 }
 
+// Same preference order as _pick_latest_onnx() in autolabel.py:
+// 'best'/'latest' in the name, then a YYYY_MM_DD date in the name, then mtime.
+static QString pickLatestOnnx(const QString &dirPath) {
+    const QFileInfoList cands = QDir(dirPath).entryInfoList({"*.onnx"}, QDir::Files);
+    if (cands.isEmpty()) return {};
+
+    static const QRegularExpression dateRe(R"((\d{4})[_-]?(\d{2})[_-]?(\d{2}))");
+    auto score = [](const QFileInfo &fi) {
+        const QString name = fi.fileName().toLower();
+        const bool preferBest = name.contains("best") || name.contains("latest");
+        const QRegularExpressionMatch m = dateRe.match(name);
+        const QString date = m.hasMatch() ? m.captured(1) + m.captured(2) + m.captured(3) : QString("00000000");
+        return std::make_tuple(preferBest, date, fi.lastModified(), fi.size());
+    };
+    return std::max_element(cands.begin(), cands.end(), [&](const QFileInfo &a, const QFileInfo &b) {
+        return score(a) < score(b);
+    })->absoluteFilePath();
+}
+
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow)
@@ -52,14 +82,89 @@ MainWindow::MainWindow(QWidget *parent) :
     m_namesPath = ""; // set when user opens names/txt file
     m_pythonPath = resolvePythonPath();
     m_autolabelScript = locateAutolabelScript();
+    m_autolabelWorker = new AutolabelWorker(this);
+    connect(m_autolabelWorker, &AutolabelWorker::labeled, this, &MainWindow::onAutolabelFinished);
+
+    m_batchStatus = new QLabel(this);
+    m_batchStatus->hide();
+    statusBar()->addPermanentWidget(m_batchStatus);
+
+    // Decoded-image cache budget, "imageCacheMB" in the settings (default 1 GiB)
+    const qint64 cacheMB = QSettings().value("imageCacheMB", 1024).toLongLong();
+    m_imageCache = new ImageCache(cacheMB << 20);
+    m_prefetcher = new ImagePrefetcher(m_imageCache, this);
+#ifdef ONNX_INFERENCE
+    m_lookahead = new AutolabelLookahead(m_imageCache, this);
+    m_lookahead->setWindow(QSettings().value("autolabelLookahead", 3).toInt());
+#endif
+
+    m_store = new AnnotationStore;
+    m_labelWriter = new LabelWriter(this);
+    connect(m_labelWriter, &LabelWriter::failed, this, [this](const QString &path, const QString &error) {
+        statusBar()->showMessage(tr("Could not save %1: %2").arg(QFileInfo(path).fileName(), error), 5000);
+    });
+
+    m_journal = new EditJournal(m_labelWriter, this);
+    ui->label_image->setEditJournal(m_journal);
+
+    m_batch = new AutolabelBatch(m_labelWriter, m_autolabelWorker, this);
+    m_batch->setStore(m_store);
+    connect(m_batch, &AutolabelBatch::labeled, this, &MainWindow::onAutolabelFinished);
+    connect(m_batch, &AutolabelBatch::progressChanged, this, &MainWindow::showBatchProgress);
+    connect(m_batch, &AutolabelBatch::finished, this, [this](const AutolabelBatch::Progress &p, bool cancelled) {
+        m_batchStatus->hide();
+        m_actBatchPause->setChecked(false);
+        statusBar()->showMessage(tr("Autolabel all %1: %2 of %3 images labeled, %4 boxes, %5 skipped, %6 failed")
+                                     .arg(cancelled ? tr("cancelled") : tr("done"))
+                                     .arg(p.labeled).arg(p.total).arg(p.boxes)
+                                     .arg(p.skipped).arg(p.failed), 8000);
+    });
+
+    m_images = new ImageDirIndex(this);
+    connect(m_images, &ImageDirIndex::changed, this, &MainWindow::onImageListChanged);
+    connect(m_images, &ImageDirIndex::enumerationFinished, this, [this](int count) {
+        if (count == 0)
+            statusBar()->showMessage(tr("No images found in %1").arg(m_images->dir()), 5000);
+        if (m_imgIndex >= 0)
+            set_label_progress(m_imgIndex);
+    });
 
     // --- add a simple menu action programmatically (or add via .ui Designer) ---
     auto *menu = menuBar()->addMenu(tr("Model"));
     auto *actChoose = menu->addAction(tr("Choose model (.pt or .onnx)…"));
     connect(actChoose, &QAction::triggered, this, &MainWindow::on_actionChooseModel_triggered);
+    menu->addSeparator();
+    connect(menu->addAction(tr("Autolabel all unlabeled images")), &QAction::triggered,
+            this, &MainWindow::startBatchAutolabel);
+    m_actBatchPause = menu->addAction(tr("Pause autolabel all"));
+    m_actBatchPause->setCheckable(true);
+    connect(m_actBatchPause, &QAction::toggled, this, [this](bool paused) {
+        if (paused) m_batch->pause(); else m_batch->resume();
+    });
+    connect(menu->addAction(tr("Cancel autolabel all")), &QAction::triggered, m_batch, &AutolabelBatch::cancel);
 
     loadModelFromSettings();           // << load persisted ONNX path
 
+    auto *labelsMenu = menuBar()->addMenu(tr("Labels"));
+    m_actLabelStore = labelsMenu->addAction(tr("Keep labels in one file per dataset"));
+    m_actLabelStore->setCheckable(true);
+    m_actLabelStore->setChecked(QSettings().value("labelStore", false).toBool());
+    connect(m_actLabelStore, &QAction::toggled, this, &MainWindow::onLabelStoreToggled);
+    auto *actExport = labelsMenu->addAction(tr("Export labels to .txt files"));
+    connect(actExport, &QAction::triggered, this, [this]() {
+        if (!m_store->isOpen()) {
+            statusBar()->showMessage(tr("Labels are already kept as .txt files"), 3000);
+            return;
+        }
+        m_labelWriter->flush();
+        statusBar()->showMessage(tr("Exported %1 label files").arg(m_store->exportText()), 5000);
+    });
+    labelsMenu->addSeparator();
+    connect(labelsMenu->addAction(tr("Export as COCO JSON…")), &QAction::triggered,
+            this, [this]() { exportLabels(LabelExporter::Coco); });
+    connect(labelsMenu->addAction(tr("Export as Pascal VOC…")), &QAction::triggered,
+            this, [this]() { exportLabels(LabelExporter::Voc); });
+
     connect(new QShortcut(QKeySequence(Qt::CTRL | Qt::Key_S), this), SIGNAL(activated()), this, SLOT(save_label_data()));
     connect(new QShortcut(QKeySequence(Qt::CTRL | Qt::Key_C), this), SIGNAL(activated()), this, SLOT(clear_label_data()));
 
@@ -87,6 +192,17 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+    m_exportCancel = true;
+    m_exportFuture.waitForFinished();
+    delete m_batch;        // saves through the writer, waits out its threads
+#ifdef ONNX_INFERENCE
+    delete m_lookahead;    // joins its inference thread before the cache goes away
+#endif
+    delete m_journal;      // settles against the writer, so before it
+    delete m_labelWriter;  // flushes queued label saves
+    delete m_store;        // after the writer, which may be saving into it
+    delete m_prefetcher;   // joins decode threads before the cache goes away
+    delete m_imageCache;
     delete ui;
 }
 
@@ -153,6 +269,16 @@ void MainWindow::updateStatusCounts()
 
 
 
+void MainWindow::updateImageCacheStats()
+{
+    const ImageCache::Stats st = m_imageCache->stats();
+    ui->label_progress->setToolTip(
+        tr("Image cache: %1 images, %2 / %3 MB\nhits %4, misses %5, evictions %6")
+            .arg(st.count)
+            .arg(st.bytes >> 20).arg(st.budget >> 20)
+            .arg(st.hits).arg(st.misses).arg(st.evictions));
+}
+
 void MainWindow::init()
 {
     m_lastLabeledImgIndex = -1;
@@ -177,7 +303,9 @@ void MainWindow::init()
 void MainWindow::set_label_progress(const int fileIndex)
 {
     QString strCurFileIndex = QString::number(fileIndex);
-    QString strEndFileIndex = QString::number(m_imgList.size() - 1);
+    QString strEndFileIndex = QString::number(m_images->size() - 1);
+    if (m_images->isEnumerating())
+        strEndFileIndex += "…";   // still listing, the total keeps growing
 
     ui->label_progress->setText(strCurFileIndex + " / " + strEndFileIndex);
 }
@@ -186,171 +314,101 @@ void MainWindow::set_focused_file(const int fileIndex)
 {
     QString str = "";
 
-    if(m_lastLabeledImgIndex >= 0)
+    if(m_lastLabeledImgIndex >= 0 && m_lastLabeledImgIndex < m_images->size())
     {
-        str += "Last Labeled Image: " + m_imgList.at(m_lastLabeledImgIndex);
+        str += "Last Labeled Image: " + m_images->at(m_lastLabeledImgIndex);
         str += '\n';
     }
 
-    str += "Current Image: " + m_imgList.at(fileIndex);
+    str += "Current Image: " + m_images->at(fileIndex);
 
     ui->textEdit_log->setText(str);
 }
 
-int MainWindow::refreshImageListForPath(const QString &currentPath)
+void MainWindow::onImageListChanged()
 {
-    if (m_imgDir.isEmpty())
-        return -1;
-
-    QDir dir(m_imgDir);
-    if (!dir.exists())
-        return -1;
-
-    QStringList patterns = {"*.jpg", "*.JPG", "*.jpeg", "*.JPEG", "*.png", "*.PNG", "*.bmp", "*.BMP"};
-    QStringList fileList = dir.entryList(patterns, QDir::Files);
-
-    QCollator collator;
-    collator.setNumericMode(true);
-    std::sort(fileList.begin(), fileList.end(), collator);
+    // Files came or went (or another listing batch arrived): follow the current
+    // image to its new position. If it was removed, m_imgIndex is -1 until the
+    // next navigation.
+    m_imgIndex = m_images->indexOf(m_imgPath);
 
-    QStringList absolutePaths;
-    absolutePaths.reserve(fileList.size());
-    for (const QString &f : fileList)
-        absolutePaths.push_back(dir.absoluteFilePath(f));
-
-    int preservedIndex = currentPath.isEmpty() ? -1 : absolutePaths.indexOf(currentPath);
-
-    m_imgList = absolutePaths;
-
-    ui->horizontalSlider_images->setEnabled(!m_imgList.isEmpty());
+    ui->horizontalSlider_images->setEnabled(!m_images->isEmpty());
     ui->horizontalSlider_images->blockSignals(true);
-    ui->horizontalSlider_images->setRange(0, m_imgList.isEmpty() ? 0 : m_imgList.size() - 1);
+    ui->horizontalSlider_images->setRange(0, m_images->isEmpty() ? 0 : m_images->size() - 1);
+    if (m_imgIndex >= 0)
+        ui->horizontalSlider_images->setValue(m_imgIndex);
     ui->horizontalSlider_images->blockSignals(false);
 
-    return preservedIndex;
-}
+    if (m_imgIndex >= 0)
+        set_label_progress(m_imgIndex);
 
-int MainWindow::refreshImageListPreserveCurrent()
-{
-    QString currentPath;
-    if (m_imgIndex >= 0 && m_imgIndex < m_imgList.size())
-        currentPath = m_imgList.at(m_imgIndex);
-    return refreshImageListForPath(currentPath);
+    // First batch of a freshly opened directory (once the class list is in)
+    if (m_imgPath.isEmpty() && !m_images->isEmpty() && !m_objList.isEmpty())
+        goto_img(0);
 }
 
 void MainWindow::goto_img(const int fileIndex)
 {
-    bool bIndexIsOutOfRange = (fileIndex < 0 || fileIndex > m_imgList.size() - 1);
+    bool bIndexIsOutOfRange = (fileIndex < 0 || fileIndex > m_images->size() - 1);
     if (bIndexIsOutOfRange) return;
 
+    if (m_imgIndex >= 0 && fileIndex != m_imgIndex)
+        m_navDirection = (fileIndex > m_imgIndex) ? +1 : -1;
     m_imgIndex = fileIndex;
+    m_imgPath  = m_images->at(m_imgIndex);
 
     bool bImgOpened;
-    ui->label_image->openImage(m_imgList.at(m_imgIndex), bImgOpened);
+    ui->label_image->setImage(m_prefetcher->load(m_imgPath), bImgOpened);
+    m_prefetcher->prefetchAround(*m_images, m_imgIndex, m_navDirection);
+    updateImageCacheStats();
 
-    QString lblPath = get_labeling_data(m_imgList.at(m_imgIndex));
-    qDebug() << "[autolabel] image =" << m_imgList.at(m_imgIndex);
+    QString lblPath = get_labeling_data(m_imgPath);
+    qDebug() << "[autolabel] image =" << m_imgPath;
     qDebug() << "[autolabel] label =" << lblPath;
 
-    ui->label_image->loadLabelData(lblPath);
+    // A save still on its way to disk is newer than the file
+    QVector<YoloLabel> queued;
+    const bool saveQueued = m_labelWriter->pending(lblPath, queued);
+    if (saveQueued)
+        ui->label_image->setLabels(queued);
+    else
+        loadLabels(lblPath);
 
     // --- Auto run model if label missing or empty ---
-    bool needAuto = true;
-    QFileInfo li(lblPath);
-    if (li.exists() && li.isFile()) {
-        QFile f(lblPath);
-        if (f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            needAuto = (f.size() == 0);
-            f.close();
-        }
-    }
+    bool needAuto = !saveQueued && labelTextSize(lblPath) <= 0;
+#ifdef ONNX_INFERENCE
     if (needAuto && !m_namesPath.isEmpty()) {
-        QString program = m_pythonPath;
-        QStringList args;
-        args << m_autolabelScript
-             << m_imgList.at(m_imgIndex)   // image path
-             << lblPath                    // label path to create
-             << m_namesPath;               // classes file
-        // If we have a persisted model, pass it as the 4th arg
-        if (!m_modelOverrideOnnx.isEmpty())
-            args << m_modelOverrideOnnx;
-
-        QProcess p;
-
-        // Environment: make Spotlight launches work (PATH) + model env var (belt & braces)
-        QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
-        QString path = env.value("PATH");
-        if (path.isEmpty()) path = "/usr/bin:/bin:/usr/sbin:/sbin";
-        if (!path.contains("/opt/homebrew/bin"))
-            path += ":/opt/homebrew/bin:/usr/local/bin";
-        env.insert("PATH", path);
-        if (!m_modelOverrideOnnx.isEmpty())
-            env.insert("YOLO_MODEL_PATH", m_modelOverrideOnnx);
-        p.setProcessEnvironment(env);
-
-        // Run from script dir so relative paths inside autolabel.py work
-        p.setWorkingDirectory(QFileInfo(m_autolabelScript).absolutePath());
-
-        p.start(program, args);
-        if (!p.waitForStarted(5000)) {
-            qDebug() << "[autolabel] failed to start" << program << ":" << p.errorString();
-        } else {
-            p.waitForFinished(60000);
-        }
-
-        qDebug() << "[autolabel] exitCode=" << p.exitCode();
-        if (auto out = p.readAllStandardOutput(); !out.isEmpty())
-            qDebug() << "[autolabel][stdout]" << out;
-        if (auto err = p.readAllStandardError(); !err.isEmpty())
-            qDebug() << "[autolabel][stderr]" << err;
-
-        // Reload labels if the script produced them
-        ui->label_image->loadLabelData(lblPath);
-    }
-
-
-
-    // --- Read one-time confidences written by autolabel.py, then delete the file ---
-    // --- Read one-time confidences written by autolabel.py, then delete the file ---
-    ui->label_image->m_confForThisImage.clear();
-    {
-        QFile jf(lblPath + ".json");
-        if (jf.exists() && jf.open(QIODevice::ReadOnly)) {
-            QJsonParseError pe;
-            const QByteArray raw = jf.readAll();
-            jf.close();
-
-            QJsonDocument doc = QJsonDocument::fromJson(raw, &pe);
-            if (pe.error == QJsonParseError::NoError) {
-                QVector<double> confs;
-
-                auto readArray = [&](const QJsonArray &arr) {
-                    for (const QJsonValue &v : arr) {
-                        if (v.isObject()) {
-                            QJsonObject o = v.toObject();
-                            if (o.contains("conf"))        confs.push_back(o.value("conf").toDouble());
-                            else if (o.contains("confidence")) confs.push_back(o.value("confidence").toDouble());
-                        } else if (v.isDouble()) {
-                            confs.push_back(v.toDouble());
-                        }
-                    }
-                };
-
-                if (doc.isArray()) {
-                    readArray(doc.array());
-                } else if (doc.isObject()) {
-                    QJsonObject o = doc.object();
-                    if (o.value("confs").isArray())       readArray(o.value("confs").toArray());
-                    else if (o.value("detections").isArray()) readArray(o.value("detections").toArray());
-                }
-
-                ui->label_image->m_confForThisImage = confs;
+        if (YoloOnnx *model = nativeModel()) {
+            // Predicted while the user was on an earlier image, or run now
+            QVector<YoloLabel> labels;
+            const bool predicted = m_lookahead->take(m_imgPath, labels);
+            if (!predicted)
+                labels = detectionsToLabels(model->infer(ui->label_image->image()));
+            qDebug() << "[autolabel][onnx]" << labels.size() << "detections" << (predicted ? "(look-ahead)" : "");
+            if (!labels.isEmpty()) {
+                // Straight into the view; saved (with scores) in the background
+                ui->label_image->setLabels(labels);
+                m_labelWriter->save(lblPath, labels);
+                m_images->noteLabelSaved(m_imgPath, labels.size());
             }
-
-            QFile::remove(lblPath + ".json"); // delete it immediately
+            needAuto = false;
         }
     }
+    if (!m_namesPath.isEmpty() && nativeModel()) {
+        m_lookahead->setModel(m_yolo);
+        m_lookahead->predictAround(*m_images, m_imgIndex, m_navDirection);
+    }
+#endif
+    if (needAuto && !m_namesPath.isEmpty()) {
+        // Python fallback: the persistent worker labels in the background and
+        // onAutolabelFinished() picks the result up if we're still on this image.
+        const QString imgPath = m_imgPath;
+        m_autolabelWorker->configure(m_pythonPath, m_autolabelScript, m_namesPath, m_modelOverrideOnnx);
+        if (m_autolabelWorker->isPending(imgPath) || m_autolabelWorker->submit(imgPath, lblPath) >= 0)
+            statusBar()->showMessage(tr("Autolabel running…"), 3000);
+    }
 
+    m_journal->setTarget(lblPath, ui->label_image->labels());
 
     emit ui->label_image->boxesChanged();
     ui->label_image->showImage();
@@ -365,98 +423,123 @@ void MainWindow::goto_img(const int fileIndex)
 }
 
 
+void MainWindow::onAutolabelFinished(const QString &imagePath, const QString &labelPath, bool ok,
+                                     const QVector<YoloLabel> &labels)
+{
+    if (!ok || labels.isEmpty())
+        return;
+
+    // autolabel.py wrote the .txt (scores in the 6th column); the store keeps its
+    // own copy. The script only checks the .txt, which doesn't exist in store
+    // mode, so labels saved meanwhile are checked here: the user's version wins.
+    if (m_store->isOpen() && QFileInfo::exists(labelPath)) {
+        QVector<YoloLabel> queued;
+        if (m_labelWriter->pending(labelPath, queued) || m_store->textSize(labelPath) > 0) {
+            QFile::remove(labelPath);
+            return;
+        }
+        m_store->adoptFile(labelPath);
+    }
+    m_images->noteLabelSaved(imagePath, labels.size());
+
+    // Only refresh if the user is still looking at this image and hasn't started labeling it
+    if (m_imgPath != imagePath)
+        return;
+    if (!ui->label_image->m_objBoundingBoxes.isEmpty())
+        return;
+
+    ui->label_image->setLabels(labels);
+    m_journal->setTarget(labelPath, labels);
+    ui->label_image->showImage();
+    statusBar()->showMessage(tr("Autolabel: %1 boxes").arg(labels.size()), 3000);
+}
+
 void MainWindow::next_img(bool bSavePrev)
 {
     if(bSavePrev && ui->label_image->isOpened()) save_label_data();
-    int currentIndex = refreshImageListPreserveCurrent();
-    if (currentIndex == -1) {
-        if (!m_imgList.isEmpty())
+    if (m_imgIndex == -1) {
+        if (!m_images->isEmpty())
             goto_img(0);
         return;
     }
-    goto_img(currentIndex + 1);
+    goto_img(m_imgIndex + 1);
 }
 
 void MainWindow::prev_img(bool bSavePrev)
 {
     if(bSavePrev) save_label_data();
-    int currentIndex = refreshImageListPreserveCurrent();
-    if (currentIndex == -1) {
-        if (!m_imgList.isEmpty())
-            goto_img(m_imgList.size() - 1);
+    if (m_imgIndex == -1) {
+        if (!m_images->isEmpty())
+            goto_img(m_images->size() - 1);
         return;
     }
-    goto_img(currentIndex - 1);
+    goto_img(m_imgIndex - 1);
 }
 
 void MainWindow::save_label_data()
 {
-    if(m_imgList.size() == 0) return;
+    if(m_imgPath.isEmpty()) return;
+
+    QString qstrOutputLabelData = get_labeling_data(m_imgPath);
 
-    QString qstrOutputLabelData = get_labeling_data(m_imgList.at(m_imgIndex));
-    ofstream fileOutputLabelData(qPrintable(qstrOutputLabelData));
+    // An empty set would race the autolabel worker that is still labeling this image
+    const bool autolabelPending = ui->label_image->m_objBoundingBoxes.isEmpty()
+                                  && m_autolabelWorker->isPending(m_imgPath);
 
-    if(fileOutputLabelData.is_open())
+    // Unchanged boxes aren't rewritten; the write itself happens in the background
+    if (ui->label_image->hasUnsavedLabels() && !autolabelPending)
     {
-        for(int i = 0; i < ui->label_image->m_objBoundingBoxes.size(); i++)
-        {
-            ObjectLabelingBox objBox = ui->label_image->m_objBoundingBoxes[i];
-
-            double midX     = objBox.box.x() + objBox.box.width() / 2.;
-            double midY     = objBox.box.y() + objBox.box.height() / 2.;
-            double width    = objBox.box.width();
-            double height   = objBox.box.height();
-
-            fileOutputLabelData << objBox.label;
-            fileOutputLabelData << " ";
-            fileOutputLabelData << std::fixed << std::setprecision(6) << midX;
-            fileOutputLabelData << " ";
-            fileOutputLabelData << std::fixed << std::setprecision(6) << midY;
-            fileOutputLabelData << " ";
-            fileOutputLabelData << std::fixed << std::setprecision(6) << width;
-            fileOutputLabelData << " ";
-            fileOutputLabelData << std::fixed << std::setprecision(6) << height << std::endl;
-        }
+        const QVector<YoloLabel> labels = ui->label_image->labels();
+        m_journal->saved(m_labelWriter->save(qstrOutputLabelData, labels), labels);
+        ui->label_image->setLabelsSaved();
         m_lastLabeledImgIndex = m_imgIndex;
-        fileOutputLabelData.close();
+        m_images->noteLabelSaved(m_imgPath, labels.size());
     }
 
     if (ui->label_image->hasPendingImageChanges()) {
-        if (!ui->label_image->saveCurrentImage(m_imgList.at(m_imgIndex))) {
-            qWarning() << "Failed to save cropped image" << m_imgList.at(m_imgIndex);
+        if (!ui->label_image->saveCurrentImage(m_imgPath)) {
+            qWarning() << "Failed to save cropped image" << m_imgPath;
         }
+        m_prefetcher->invalidate(m_imgPath);
     }
 }
 
 void MainWindow::clear_label_data()
 {
-    ui->label_image->m_objBoundingBoxes.clear();
+    ui->label_image->clearBoxes();
     ui->label_image->showImage();
 }
 
 void MainWindow::remove_img()
 {
-    if(m_imgList.size() > 0) {
+    if(!m_imgPath.isEmpty()) {
         //remove a image
-        QFile::remove(m_imgList.at(m_imgIndex));
+        QFile::remove(m_imgPath);
+        m_prefetcher->invalidate(m_imgPath);
 
         //remove a txt file
-        QString qstrOutputLabelData = get_labeling_data(m_imgList.at(m_imgIndex));
-        QFile::remove(qstrOutputLabelData);
-
-        m_imgList.removeAt(m_imgIndex);
-
-        if(m_imgList.size() == 0)
+        QString qstrOutputLabelData = get_labeling_data(m_imgPath);
+        m_journal->discard(qstrOutputLabelData);
+        m_labelWriter->discard(qstrOutputLabelData);
+        if (m_store->isOpen())
+            m_store->remove(qstrOutputLabelData);
+        else
+            QFile::remove(qstrOutputLabelData);
+
+        m_images->remove(m_imgPath);
+        m_imgPath.clear();
+
+        if(m_images->size() == 0)
         {
             pjreddie_style_msgBox(QMessageBox::Information,"End", "In directory, there are not any image. program quit.");
             QCoreApplication::quit();
         }
-        else if( m_imgIndex == m_imgList.size())
+        else if( m_imgIndex >= m_images->size())
         {
-            m_imgIndex--;
+            m_imgIndex = m_images->size() - 1;
         }
 
-        goto_img(m_imgIndex);
+        goto_img(std::max(0, m_imgIndex));
     }
 }
 
@@ -524,6 +607,185 @@ void MainWindow::load_label_list_data(QString qstrLabelListFile)
     }
 }
 
+// Labels live in a sibling folder; derive it the same way per-image paths are
+QString MainWindow::labelDirFor(const QString &imgDir) const
+{
+    return QFileInfo(get_labeling_data(QDir(imgDir).filePath("_.jpg"))).absolutePath();
+}
+
+// Label text size from the active backend, -1 if there is no label yet
+qint64 MainWindow::labelTextSize(const QString &lblPath) const
+{
+    if (m_store->isOpen())
+        return m_store->textSize(lblPath);
+    const QFileInfo li(lblPath);
+    return li.isFile() ? li.size() : -1;
+}
+
+void MainWindow::loadLabels(const QString &lblPath)
+{
+    if (!m_store->isOpen()) {
+        ui->label_image->loadLabelData(lblPath);
+        return;
+    }
+    QVector<YoloLabel> labels;
+    const bool stored = m_store->read(lblPath, labels);
+    ui->label_image->setLabels(labels, stored);
+}
+
+static QString formatDuration(qint64 msecs)
+{
+    const qint64 s = msecs / 1000;
+    return QString("%1:%2:%3").arg(s / 3600).arg(s / 60 % 60, 2, 10, QChar('0')).arg(s % 60, 2, 10, QChar('0'));
+}
+
+void MainWindow::startBatchAutolabel()
+{
+    if (m_imgDir.isEmpty() || m_images->isEmpty() || m_namesPath.isEmpty()) {
+        statusBar()->showMessage(tr("Open a dataset first"), 3000);
+        return;
+    }
+    if (m_batch->isRunning()) {
+        statusBar()->showMessage(tr("Autolabel all is already running"), 3000);
+        return;
+    }
+
+    // The current image's boxes count as labels
+    save_label_data();
+
+    m_autolabelWorker->configure(m_pythonPath, m_autolabelScript, m_namesPath, m_modelOverrideOnnx);
+#ifdef ONNX_INFERENCE
+    // Threads per image on top of ORT's own, "autolabelThreads" in the settings
+    const int threads = QSettings().value("autolabelThreads", 2).toInt();
+    m_batch->setModel(nativeModel() ? m_yolo : std::shared_ptr<YoloOnnx>(), threads);
+#endif
+
+    m_actBatchPause->setChecked(false);
+    const int queued = m_batch->start(m_imgDir, m_images->snapshot(), labelDirFor(m_imgDir));
+    if (queued <= 0) {
+        statusBar()->showMessage(tr("Every image already has labels"), 3000);
+        return;
+    }
+    m_batchStatus->show();
+    showBatchProgress();
+}
+
+void MainWindow::showBatchProgress()
+{
+    const AutolabelBatch::Progress &p = m_batch->progress();
+    QString text = tr("Autolabel all: %1 / %2").arg(p.done).arg(p.total);
+    if (m_batch->isPaused())
+        text += tr(" (paused)");
+    else if (p.done > 0)
+        text += tr(", %1 images/s, %2 left").arg(p.imagesPerSec(), 0, 'f', 1).arg(formatDuration(p.etaMsecs()));
+    m_batchStatus->setText(text);
+}
+
+void MainWindow::exportLabels(int format)
+{
+    if (m_imgDir.isEmpty() || m_images->isEmpty()) {
+        statusBar()->showMessage(tr("Open a dataset first"), 3000);
+        return;
+    }
+    if (m_exportFuture.isRunning()) {
+        statusBar()->showMessage(tr("An export is already running"), 3000);
+        return;
+    }
+
+    const bool coco = format == LabelExporter::Coco;
+    const QString out = coco
+        ? QFileDialog::getSaveFileName(this, tr("Export COCO JSON"),
+                                       QDir(m_imgDir).filePath("../annotations.json"), tr("JSON (*.json)"))
+        : QFileDialog::getExistingDirectory(this, tr("Export Pascal VOC into"), QDir(m_imgDir).filePath(".."));
+    if (out.isEmpty())
+        return;
+
+    // Export what the user sees, current image included
+    save_label_data();
+    m_labelWriter->flush();
+
+    auto exporter = std::make_shared<LabelExporter>(m_imgDir, m_images->snapshot(), labelDirFor(m_imgDir), m_objList);
+    if (m_store->isOpen())
+        exporter->setStore(m_store);
+
+    m_exportCancel = false;
+    m_exportFuture = QtConcurrent::run([this, exporter, format, out]() {
+        QString error;
+        const bool ok = exporter->run(LabelExporter::Format(format), out, m_exportCancel,
+                                      [this](qint64 done, qint64 total) {
+            QMetaObject::invokeMethod(this, [this, done, total]() {
+                statusBar()->showMessage(tr("Exporting labels… %1 / %2").arg(done).arg(total));
+            }, Qt::QueuedConnection);
+        }, &error);
+
+        const LabelExporter::Stats st = exporter->stats();
+        QMetaObject::invokeMethod(this, [this, ok, error, st]() {
+            if (!ok) {
+                statusBar()->showMessage(tr("Export failed: %1").arg(error), 8000);
+                return;
+            }
+            statusBar()->showMessage(tr("Exported %1 images, %2 boxes in %3 s (%4 images/s)")
+                                         .arg(st.images).arg(st.boxes)
+                                         .arg(st.msecs / 1000.0, 0, 'f', 1)
+                                         .arg(st.imagesPerSec(), 0, 'f', 0), 8000);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::openLabelBackend(const QString &imgDir, bool useStore)
+{
+    // Batch autolabel, journal, writer and a running export settle against
+    // the old backend before it goes
+    m_batch->cancel();
+    m_exportCancel = true;
+    m_exportFuture.waitForFinished();
+    m_journal->close();
+    m_labelWriter->setStore(nullptr);
+    m_store->close();
+
+    if (useStore) {
+        const bool fresh = !AnnotationStore::exists(imgDir);
+        if (m_store->open(imgDir, labelDirFor(imgDir))) {
+            if (fresh) {
+                QApplication::setOverrideCursor(Qt::WaitCursor);
+                const int n = m_store->importText();
+                QApplication::restoreOverrideCursor();
+                statusBar()->showMessage(tr("Imported %1 label files into the label store").arg(n), 5000);
+            }
+            m_labelWriter->setStore(m_store);
+        }
+    }
+
+    if (const int recovered = m_journal->open(imgDir))
+        statusBar()->showMessage(tr("Recovered unsaved labels for %n image(s)", nullptr, recovered), 5000);
+}
+
+void MainWindow::onLabelStoreToggled(bool on)
+{
+    QSettings().setValue("labelStore", on);
+    if (m_imgDir.isEmpty())
+        return;
+
+    save_label_data();
+    if (on) {
+        openLabelBackend(m_imgDir, true);
+        return;
+    }
+
+    // Back to .txt files: write them all out, then drop the store so turning
+    // it on again starts from the .txt files rather than stale contents
+    int exported = -1;
+    if (m_store->isOpen()) {
+        m_labelWriter->flush();
+        exported = m_store->exportText();
+    }
+    openLabelBackend(m_imgDir, false);
+    if (exported >= 0) {
+        QFile::remove(AnnotationStore::pathFor(m_imgDir));
+        statusBar()->showMessage(tr("Exported %1 label files").arg(exported), 5000);
+    }
+}
+
 QString MainWindow::get_labeling_data(QString qstrImgFile) const
 {
     QFileInfo fi(qstrImgFile);
@@ -628,18 +890,9 @@ void MainWindow::open_img_dir(bool& ret)
                 opened_dir,
                 QFileDialog::ShowDirsOnly);
 
-    QDir dir(imgDir);
-    QCollator collator;
-    collator.setNumericMode(true);
-
-    QStringList fileList = dir.entryList(
-                QStringList() << "*.jpg" << "*.JPG" << "*.jpeg" << "*.JPEG"
-                               << "*.png" << "*.PNG" << "*.bmp" << "*.BMP",
-                QDir::Files);
+    const QString labelDir = imgDir.isEmpty() ? QString() : labelDirFor(imgDir);
 
-    std::sort(fileList.begin(), fileList.end(), collator);
-
-    if(fileList.empty())
+    if(imgDir.isEmpty() || !m_images->open(imgDir, labelDir))
     {
         ret = false;
         return;  // silently ignore instead of popup
@@ -648,11 +901,10 @@ void MainWindow::open_img_dir(bool& ret)
     else
     {
         ret = true;
+        openLabelBackend(imgDir, m_actLabelStore->isChecked());
         m_imgDir    = imgDir;
-        m_imgList  = fileList;
-
-        for(QString& str: m_imgList)
-            str = m_imgDir + "/" + str;
+        m_imgIndex  = -1;
+        m_imgPath.clear();
     }
 }
 
@@ -772,7 +1024,6 @@ void MainWindow::on_lineEdit_class_filter_textChanged(const QString &text)
 
 void MainWindow::on_horizontalSlider_images_sliderMoved(int position)
 {
-    refreshImageListForPath(QString());
     goto_img(position);
 }
 
@@ -784,7 +1035,7 @@ void MainWindow::init_button_event()
 void MainWindow::init_horizontal_slider()
 {
     ui->horizontalSlider_images->setEnabled(true);
-    ui->horizontalSlider_images->setRange(0, m_imgList.size() - 1);
+    ui->horizontalSlider_images->setRange(0, m_images->size() - 1);
     ui->horizontalSlider_images->blockSignals(true);
     ui->horizontalSlider_images->setValue(0);
     ui->horizontalSlider_images->blockSignals(false);
@@ -879,6 +1130,53 @@ int MainWindow::findNextVisibleRow(int start, int step) const
     }
 }
 
+QString MainWindow::resolveModelPath() const {
+    if (!m_modelOverrideOnnx.isEmpty())
+        return m_modelOverrideOnnx;
+
+    // Same order as autolabel.py: the YOLO_MODEL_PATH environment variable,
+    // then next to the script, then a nested 'models' folder
+    QString env = qEnvironmentVariable("YOLO_MODEL_PATH");
+    if (!env.isEmpty()) {
+        if (env == "~" || env.startsWith("~/"))
+            env.replace(0, 1, QDir::homePath());
+        return QFileInfo(env).absoluteFilePath();
+    }
+
+    const QString scriptDir = QFileInfo(m_autolabelScript).absolutePath();
+    QString onnx = pickLatestOnnx(scriptDir);
+    if (onnx.isEmpty())
+        onnx = pickLatestOnnx(scriptDir + "/models");
+    return onnx;
+}
+
+#ifdef ONNX_INFERENCE
+YoloOnnx *MainWindow::nativeModel() {
+    const QString modelPath = resolveModelPath();
+    if (modelPath.isEmpty() || !QFileInfo::exists(modelPath))
+        return nullptr;
+
+    // (Re)load only when the model changes; the session is reused for every image
+    if (!m_yolo || m_yolo->modelPath() != modelPath) {
+        m_yolo = std::make_shared<YoloOnnx>(modelPath, 640, 640, 0.35f, 0.60f);
+        if (m_yolo->isReady())
+            statusBar()->showMessage(tr("Autolabel: in-process model %1").arg(modelPath), 4000);
+    }
+    if (!m_yolo->isReady())
+        return nullptr;
+
+    // The model is shared with the batch and lookahead threads: only write
+    // when the class list or the setting actually changed
+    const int numClasses = m_objList.size();
+    const bool agnostic = QSettings().value("autolabelAgnosticNms", false).toBool();
+    if (m_yolo->numClasses() != numClasses)
+        m_yolo->setNumClasses(numClasses);
+    if (m_yolo->classAgnosticNms() != agnostic)
+        m_yolo->setClassAgnosticNms(agnostic);
+    return m_yolo.get();
+}
+#endif
+
 QString MainWindow::appModelsDir() const {
     const QString base = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
     QDir d(base + "/models");
@@ -6,6 +6,7 @@
 #endif
 
 #include <QMainWindow>
+#include <QVector>
 #include <QWheelEvent>
 #include <QTableWidgetItem>
 #include <QMessageBox>
@@ -15,11 +16,28 @@
 #include <QSettings>
 #include <QStandardPaths>
 #include <QProcessEnvironment>
+#include <memory>
+#include <atomic>
+#include <QFuture>
+
+#include "yolo_label_io.h"
 
 namespace Ui {
 class MainWindow;
 }
 
+class AutolabelWorker;
+class AutolabelBatch;
+class AutolabelLookahead;
+class ImagePrefetcher;
+class ImageCache;
+class ImageDirIndex;
+class LabelWriter;
+class EditJournal;
+class AnnotationStore;
+class QAction;
+class QLabel;
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -57,8 +75,16 @@ private slots:
 
     void on_checkBox_visualize_class_name_clicked(bool checked);
 
+    void onAutolabelFinished(const QString &imagePath, const QString &labelPath, bool ok,
+                             const QVector<YoloLabel> &labels);
+    void onImageListChanged();
+    void onLabelStoreToggled(bool on);
+    void exportLabels(int format);
+    void startBatchAutolabel();
+
 private:
     void updateStatusCounts();
+    void updateImageCacheStats();
     void applyClassFilter(const QString &text);
     int findNextVisibleRow(int start, int step) const;
 
@@ -73,6 +99,19 @@ private:
     QString m_namesPath;
     QString m_pythonPath;
     QString m_autolabelScript; 
+    QString resolveModelPath() const;          // override, else newest bundled .onnx
+
+    AutolabelWorker *m_autolabelWorker;      // persistent autolabel.py --serve
+    AutolabelBatch  *m_batch;                // "Autolabel all", in the background
+    QAction         *m_actBatchPause;
+    QLabel          *m_batchStatus;          // progress/ETA in the status bar while it runs
+    void            showBatchProgress();
+
+#ifdef ONNX_INFERENCE
+    std::shared_ptr<YoloOnnx> m_yolo;          // in-process model, session kept across images; shared with m_batch
+    YoloOnnx *nativeModel();
+    AutolabelLookahead *m_lookahead;           // predicts the next images in the direction of travel
+#endif
     void            init();
     void            init_table_widget();
     void            init_button_event();
@@ -83,11 +122,13 @@ private:
     void            set_focused_file(const int);
 
     void            goto_img(const int);
-    int             refreshImageListForPath(const QString &currentPath);
-    int             refreshImageListPreserveCurrent();
 
     void            load_label_list_data(QString);
     QString         get_labeling_data(QString)const;
+    QString         labelDirFor(const QString &imgDir) const;
+    qint64          labelTextSize(const QString &lblPath) const;
+    void            loadLabels(const QString &lblPath);
+    void            openLabelBackend(const QString &imgDir, bool useStore);
 
     void            set_label(const int);
     void            set_label_color(const int , const QColor);
@@ -100,8 +141,19 @@ private:
     Ui::MainWindow *ui;
 
     QString         m_imgDir;
-    QStringList     m_imgList;
-    int             m_imgIndex;
+    ImageDirIndex  *m_images;                  // sorted images of m_imgDir, kept live by fs events
+    int             m_imgIndex = -1;
+    QString         m_imgPath;                 // image on screen; m_imgIndex follows it across reindexing
+    int             m_navDirection = +1;       // +1 forward, -1 backward; steers prefetch
+
+    ImageCache      *m_imageCache;             // decoded images, byte-budgeted LRU
+    ImagePrefetcher *m_prefetcher;
+    LabelWriter     *m_labelWriter;            // background, atomic label saves
+    EditJournal     *m_journal;                // box edits since the last save, for crash recovery
+    AnnotationStore *m_store;                  // single-file labels, open when m_actLabelStore is on
+    QAction         *m_actLabelStore;
+    QFuture<void>    m_exportFuture;           // LabelExporter run, one at a time
+    std::atomic_bool m_exportCancel{false};
 
     QStringList     m_objList;
     int             m_objIndex;
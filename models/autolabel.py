@@ -10,19 +10,27 @@ from pathlib import Path
 
 SCRIPT_DIR = Path(__file__).resolve().parent
 
-# Usage: autolabel.py <image_path> <label_path> <names_path>
+# Usage: autolabel.py <image_path> <label_path> <names_path> [model]
+#        autolabel.py --serve <names_path> [model]
 # names_path is a .names or .txt where each line is class name
-if len(sys.argv) < 4:
-    print("usage: autolabel.py <image> <label_txt> <names_file>", file=sys.stderr)
-    sys.exit(2)
-
-img_path, label_path, names_path = sys.argv[1], sys.argv[2], sys.argv[3]
+#
+# --serve keeps the model loaded and answers one JSON request per stdin line:
+#   {"id": 1, "image": "/a/b.jpg", "label": "/a/labels/b.txt"}
+# with one JSON reply per stdout line:
+#   {"id": 1, "ok": true, "count": 1, "boxes": [[cls, cx, cy, w, h, conf]]}
+# Logs go to stderr in this mode so stdout only carries replies.
 conf_thres = 0.35
 iou_thres = 0.60
 imgsz = 640  # adjust if your model expects another input size
 
-with open(names_path, "r", encoding="utf-8") as f:
-    names = [ln.strip() for ln in f if ln.strip()]
+
+def log(msg):
+    print(msg, file=sys.stderr, flush=True)
+
+
+def load_names(names_path):
+    with open(names_path, "r", encoding="utf-8") as f:
+        return [ln.strip() for ln in f if ln.strip()]
 
 def _pick_latest_onnx(base: Path, pattern: str = "*.onnx") -> Path:
     """
@@ -80,140 +88,214 @@ def nms(boxes, scores, iou=0.7):
         order=order[inds+1]
     return keep
 
-# --- Resolve MODEL_PATH with overrides and sensible fallbacks ---
-# Priority 1: CLI arg (4th arg): autolabel.py <image> <label> <names> <model>
-model_override = sys.argv[4] if len(sys.argv) >= 5 else None
-
-# Priority 2: env var
-env_override = os.environ.get("YOLO_MODEL_PATH")
+def resolve_model_path(model_override=None):
+    # --- Resolve MODEL_PATH with overrides and sensible fallbacks ---
+    # Priority 1: CLI arg
+    # Priority 2: env var
+    env_override = os.environ.get("YOLO_MODEL_PATH")
 
-MODEL_PATH = None
-if model_override:
-    MODEL_PATH = str(Path(model_override).expanduser().resolve())
-elif env_override:
-    MODEL_PATH = str(Path(env_override).expanduser().resolve())
-else:
+    if model_override:
+        return str(Path(model_override).expanduser().resolve())
+    if env_override:
+        return str(Path(env_override).expanduser().resolve())
     # Try current folder first (where autolabel.py lives)
     try:
-        MODEL_PATH = str(_pick_latest_onnx(SCRIPT_DIR))
+        return str(_pick_latest_onnx(SCRIPT_DIR))
     except FileNotFoundError:
         # Then try a nested 'models' folder (works if script sits one level up)
-        MODEL_PATH = str(_pick_latest_onnx(SCRIPT_DIR / "models"))
-
-print(f"[autolabel] Using model: {MODEL_PATH}")
-
-# Load & preprocess
-img0 = cv2.imread(img_path)
-if img0 is None:
-    sys.exit(0)
-img, r, left, top = letterbox(img0, imgsz)
-inp = img[:, :, ::-1].transpose(2,0,1) / 255.0
-inp = np.expand_dims(inp.astype(np.float32), 0)
-
-# Infer
-
-if not Path(MODEL_PATH).exists():
-    print(f"[autolabel] Model not found: {MODEL_PATH}", file=sys.stderr)
-    sys.exit(1)
-
-# Infer
-session = ort.InferenceSession(MODEL_PATH, providers=["CPUExecutionProvider"])
-inp_name = session.get_inputs()[0].name
-out = session.run(None, {inp_name: inp})[0]  # typically (1, F, N) or (1, N, F) or (N, F)
-
-# Normalize to (N, F) where F = 4 + num_classes
-o = out
-if o.ndim == 3:
-    o = o[0]  # drop batch
-
-num_classes = len(names)
-feat = 4 + num_classes
-
-if o.ndim != 2:
-    raise RuntimeError(f"Unexpected output ndim={o.ndim}, shape={o.shape}")
-
-# If features are first, transpose to (N, F)
-if o.shape[0] == feat:
-    o = o.transpose(1, 0)
-elif o.shape[1] == feat:
-    pass  # already (N, F)
-else:
-    raise RuntimeError(f"Unexpected output shape {o.shape}; can't find feature dim {feat}")
-
-# Split into boxes and class scores
-boxes = o[:, :4]          # xywh in pixels of letterboxed input
-cls_scores = o[:, 4:]     # per-class scores (shape: 8400, 60)
-
-# Get best score and class per detection
-sc = cls_scores.max(axis=1)
-cl = cls_scores.argmax(axis=1)
-
-# Center X/Y, width, height in pixels (letterboxed space)
-cx, cy, w, h = boxes.T
-
-
-
-keep = sc >= conf_thres
-cx, cy, w, h, sc, cl = cx[keep], cy[keep], w[keep], h[keep], sc[keep], cl[keep].astype(int)
-
-# Convert to xyxy in padded (letterbox) coordinates then back to original
-# Convert to xyxy in *pixels* of the letterboxed input (no extra scaling)
-xyxy = np.stack([cx - w/2, cy - h/2, cx + w/2, cy + h/2], axis=1)
-
-# Undo padding/scale back to original image coordinates
-xyxy[:, [0, 2]] -= left
-xyxy[:, [1, 3]] -= top
-xyxy = xyxy / r
-
-# Clip to image size
-H, W = img0.shape[:2]
-xyxy[:, 0] = np.clip(xyxy[:, 0], 0, W - 1)
-xyxy[:, 2] = np.clip(xyxy[:, 2], 0, W - 1)
-xyxy[:, 1] = np.clip(xyxy[:, 1], 0, H - 1)
-xyxy[:, 3] = np.clip(xyxy[:, 3], 0, H - 1)
-
-# Simple NMS per class (same as before)
-final = []
-valid_classes = set(range(len(names)))
-for c in np.unique(cl):
-    if c not in valid_classes:
-        continue
-    m = cl == c
-    keep_idx = nms(xyxy[m], sc[m], iou=iou_thres)
-    for k in keep_idx:
-        box = xyxy[m][k]
-        conf = float(sc[m][k])
-        final.append((int(c), box, conf))
-
-# Write YOLO txt (class cx cy w h) normalized to [0,1]
-out_lines = []
-conf_records = []
-for entry in final:
-    # entry is (cls, box, conf) OR (cls, box)
-    if len(entry) == 3:
-        c, (x1, y1, x2, y2), conf = entry
+        return str(_pick_latest_onnx(SCRIPT_DIR / "models"))
+
+
+def load_session(model_path):
+    if not Path(model_path).exists():
+        raise FileNotFoundError(f"Model not found: {model_path}")
+    return ort.InferenceSession(model_path, providers=["CPUExecutionProvider"])
+
+
+def detect(session, img_path, names):
+    """Returns ([(cls, (x1, y1, x2, y2), conf), ...], W, H) in original image pixels,
+    or None if the image can't be read."""
+    res = candidates(session, img_path, names)
+    if res is None:
+        return None
+    xyxy, sc, cl, W, H = res
+    return per_class_nms(xyxy, sc, cl, names), W, H
+
+
+def candidates(session, img_path, names):
+    """Boxes above conf_thres before NMS: (xyxy, scores, classes, W, H), boxes
+    in original image pixels, or None if the image can't be read."""
+    # Load & preprocess
+    img0 = cv2.imread(img_path)
+    if img0 is None:
+        return None
+    img, r, left, top = letterbox(img0, imgsz)
+    inp = img[:, :, ::-1].transpose(2,0,1) / 255.0
+    inp = np.expand_dims(inp.astype(np.float32), 0)
+
+    # Infer
+    inp_name = session.get_inputs()[0].name
+    out = session.run(None, {inp_name: inp})[0]  # typically (1, F, N) or (1, N, F) or (N, F)
+
+    # Normalize to (N, F) where F = 4 + num_classes
+    o = out
+    if o.ndim == 3:
+        o = o[0]  # drop batch
+
+    num_classes = len(names)
+    feat = 4 + num_classes
+
+    if o.ndim != 2:
+        raise RuntimeError(f"Unexpected output ndim={o.ndim}, shape={o.shape}")
+
+    # If features are first, transpose to (N, F)
+    if o.shape[0] == feat:
+        o = o.transpose(1, 0)
+    elif o.shape[1] == feat:
+        pass  # already (N, F)
     else:
-        c, (x1, y1, x2, y2) = entry
-        conf = None
-
-    bw = x2 - x1
-    bh = y2 - y1
-    cx_abs = x1 + bw / 2.0
-    cy_abs = y1 + bh / 2.0
-
-    # write normalized YOLO (cx, cy, w, h)
-    out_lines.append(f"{int(c)} {cx_abs/W:.6f} {cy_abs/H:.6f} {bw/W:.6f} {bh/H:.6f}")
-
-    if conf is not None:
-        conf_records.append({"cls": int(c), "conf": float(conf)})
-
-
-
-if out_lines:
-    os.makedirs(os.path.dirname(label_path), exist_ok=True)
-    with open(label_path, "w") as f:
-        f.write("\n".join(out_lines))
-    # optional: write confidences for the UI to show on first load
-    if conf_records:
-        with open(label_path + ".json", "w") as jf:
-            json.dump(conf_records, jf)
+        raise RuntimeError(f"Unexpected output shape {o.shape}; can't find feature dim {feat}")
+
+    # Split into boxes and class scores
+    boxes = o[:, :4]          # xywh in pixels of letterboxed input
+    cls_scores = o[:, 4:]     # per-class scores (shape: 8400, 60)
+
+    # Get best score and class per detection
+    sc = cls_scores.max(axis=1)
+    cl = cls_scores.argmax(axis=1)
+
+    # Center X/Y, width, height in pixels (letterboxed space)
+    cx, cy, w, h = boxes.T
+
+    keep = sc >= conf_thres
+    cx, cy, w, h, sc, cl = cx[keep], cy[keep], w[keep], h[keep], sc[keep], cl[keep].astype(int)
+
+    # Convert to xyxy in *pixels* of the letterboxed input (no extra scaling)
+    xyxy = np.stack([cx - w/2, cy - h/2, cx + w/2, cy + h/2], axis=1)
+
+    # Undo padding/scale back to original image coordinates
+    xyxy[:, [0, 2]] -= left
+    xyxy[:, [1, 3]] -= top
+    xyxy = xyxy / r
+
+    # Clip to image size
+    H, W = img0.shape[:2]
+    xyxy[:, 0] = np.clip(xyxy[:, 0], 0, W - 1)
+    xyxy[:, 2] = np.clip(xyxy[:, 2], 0, W - 1)
+    xyxy[:, 1] = np.clip(xyxy[:, 1], 0, H - 1)
+    xyxy[:, 3] = np.clip(xyxy[:, 3], 0, H - 1)
+    return xyxy, sc, cl, W, H
+
+
+def per_class_nms(xyxy, sc, cl, names):
+    # Simple NMS per class (same as before)
+    final = []
+    valid_classes = set(range(len(names)))
+    for c in np.unique(cl):
+        if c not in valid_classes:
+            continue
+        m = cl == c
+        keep_idx = nms(xyxy[m], sc[m], iou=iou_thres)
+        for k in keep_idx:
+            box = xyxy[m][k]
+            conf = float(sc[m][k])
+            final.append((int(c), box, conf))
+    return final
+
+
+def write_labels(label_path, final, W, H):
+    # Write YOLO txt (class cx cy w h [conf]) normalized to [0,1]; the
+    # confidence goes in a 6th column, which YoloLabel reads back.
+    # Returns the boxes as [cls, cx, cy, w, h, conf] for the --serve reply.
+    out_lines = []
+    boxes = []
+    for entry in final:
+        # entry is (cls, box, conf) OR (cls, box)
+        if len(entry) == 3:
+            c, (x1, y1, x2, y2), conf = entry
+        else:
+            c, (x1, y1, x2, y2) = entry
+            conf = None
+
+        bw = x2 - x1
+        bh = y2 - y1
+        cx_abs = x1 + bw / 2.0
+        cy_abs = y1 + bh / 2.0
+
+        # write normalized YOLO (cx, cy, w, h[, conf])
+        line = f"{int(c)} {cx_abs/W:.6f} {cy_abs/H:.6f} {bw/W:.6f} {bh/H:.6f}"
+        if conf is not None:
+            line += f" {float(conf):.6f}"
+        out_lines.append(line)
+        boxes.append([int(c), round(cx_abs / W, 6), round(cy_abs / H, 6), round(bw / W, 6), round(bh / H, 6),
+                      round(float(conf), 6) if conf is not None else 1.0])
+
+    if out_lines:
+        os.makedirs(os.path.dirname(label_path), exist_ok=True)
+        with open(label_path, "w") as f:
+            f.write("\n".join(out_lines) + "\n")
+    return boxes
+
+
+def label_is_empty(label_path):
+    try:
+        return os.path.getsize(label_path) == 0
+    except OSError:
+        return True
+
+
+def serve(names_path, model_override):
+    names = load_names(names_path)
+    model_path = resolve_model_path(model_override)
+    log(f"[autolabel] Using model: {model_path}")
+    session = load_session(model_path)
+
+    for line in sys.stdin:
+        line = line.strip()
+        if not line:
+            continue
+        reply = {"ok": False}
+        try:
+            req = json.loads(line)
+            reply["id"] = req.get("id")
+            res = detect(session, req["image"], names)
+            boxes = []
+            # Don't clobber labels the user saved while this request was queued
+            if res is not None and label_is_empty(req["label"]):
+                final, W, H = res
+                boxes = write_labels(req["label"], final, W, H)
+            reply.update(ok=True, count=len(boxes), boxes=boxes)
+        except Exception as e:
+            reply["error"] = str(e)
+        sys.stdout.write(json.dumps(reply) + "\n")
+        sys.stdout.flush()
+
+
+def main():
+    if len(sys.argv) >= 3 and sys.argv[1] == "--serve":
+        serve(sys.argv[2], sys.argv[3] if len(sys.argv) >= 4 else None)
+        return
+
+    if len(sys.argv) < 4:
+        print("usage: autolabel.py <image> <label_txt> <names_file> [model]\n"
+              "       autolabel.py --serve <names_file> [model]", file=sys.stderr)
+        sys.exit(2)
+
+    img_path, label_path, names_path = sys.argv[1], sys.argv[2], sys.argv[3]
+    names = load_names(names_path)
+    MODEL_PATH = resolve_model_path(sys.argv[4] if len(sys.argv) >= 5 else None)
+    print(f"[autolabel] Using model: {MODEL_PATH}")
+
+    if not Path(MODEL_PATH).exists():
+        print(f"[autolabel] Model not found: {MODEL_PATH}", file=sys.stderr)
+        sys.exit(1)
+
+    res = detect(load_session(MODEL_PATH), img_path, names)
+    if res is None:
+        sys.exit(0)
+    final, W, H = res
+    write_labels(label_path, final, W, H)
+
+
+if __name__ == "__main__":
+    main()
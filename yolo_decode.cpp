@@ -0,0 +1,180 @@
+#include "yolo_decode.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define DEC_X86_DISPATCH 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define DEC_NEON 1
+#endif
+
+// Anchors per pass over the class rows (F x N): 4 KiB of running maxima
+static const int kBlock = 1024;
+
+typedef void  (*RowMaxKernel)(float *acc, const float *row, int n);   // acc = max(acc, row)
+typedef float (*MaxOfKernel)(const float *p, int n);                 // n >= 1
+
+static void rowMaxScalar(float *acc, const float *row, int n)
+{
+    for (int i = 0; i < n; ++i)
+        acc[i] = std::max(acc[i], row[i]);
+}
+
+static float maxOfScalar(const float *p, int n)
+{
+    float m = p[0];
+    for (int i = 1; i < n; ++i)
+        m = std::max(m, p[i]);
+    return m;
+}
+
+#if DEC_X86_DISPATCH
+__attribute__((target("sse")))
+static void rowMaxSse(float *acc, const float *row, int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(acc + i, _mm_max_ps(_mm_loadu_ps(acc + i), _mm_loadu_ps(row + i)));
+    rowMaxScalar(acc + i, row + i, n - i);
+}
+
+__attribute__((target("sse")))
+static float maxOfSse(const float *p, int n)
+{
+    if (n < 4)
+        return maxOfScalar(p, n);
+    __m128 m = _mm_loadu_ps(p);
+    int i = 4;
+    for (; i + 4 <= n; i += 4)
+        m = _mm_max_ps(m, _mm_loadu_ps(p + i));
+    float lanes[4];
+    _mm_storeu_ps(lanes, m);
+    float r = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    for (; i < n; ++i)
+        r = std::max(r, p[i]);
+    return r;
+}
+
+__attribute__((target("avx")))
+static void rowMaxAvx(float *acc, const float *row, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(acc + i, _mm256_max_ps(_mm256_loadu_ps(acc + i), _mm256_loadu_ps(row + i)));
+    rowMaxScalar(acc + i, row + i, n - i);
+}
+
+__attribute__((target("avx")))
+static float maxOfAvx(const float *p, int n)
+{
+    if (n < 8)
+        return maxOfScalar(p, n);
+    __m256 m = _mm256_loadu_ps(p);
+    int i = 8;
+    for (; i + 8 <= n; i += 8)
+        m = _mm256_max_ps(m, _mm256_loadu_ps(p + i));
+    float lanes[8];
+    _mm256_storeu_ps(lanes, m);
+    float r = lanes[0];
+    for (int k = 1; k < 8; ++k)
+        r = std::max(r, lanes[k]);
+    for (; i < n; ++i)
+        r = std::max(r, p[i]);
+    return r;
+}
+#endif
+
+#if DEC_NEON
+static void rowMaxNeon(float *acc, const float *row, int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+        vst1q_f32(acc + i, vmaxq_f32(vld1q_f32(acc + i), vld1q_f32(row + i)));
+    rowMaxScalar(acc + i, row + i, n - i);
+}
+
+static float maxOfNeon(const float *p, int n)
+{
+    if (n < 4)
+        return maxOfScalar(p, n);
+    float32x4_t m = vld1q_f32(p);
+    int i = 4;
+    for (; i + 4 <= n; i += 4)
+        m = vmaxq_f32(m, vld1q_f32(p + i));
+    float r = vmaxvq_f32(m);
+    for (; i < n; ++i)
+        r = std::max(r, p[i]);
+    return r;
+}
+#endif
+
+struct Kernels {
+    RowMaxKernel rowMax;
+    MaxOfKernel  maxOf;
+};
+
+static Kernels pickKernels()
+{
+#if DEC_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx"))
+        return {rowMaxAvx, maxOfAvx};
+    if (__builtin_cpu_supports("sse"))
+        return {rowMaxSse, maxOfSse};
+    return {rowMaxScalar, maxOfScalar};
+#elif DEC_NEON
+    return {rowMaxNeon, maxOfNeon};
+#else
+    return {rowMaxScalar, maxOfScalar};
+#endif
+}
+
+void decodeYoloOutput(const float *out, int64_t anchors, int numClasses, bool featuresFirst,
+                      float confTh, std::vector<YoloCandidate> &cands)
+{
+    static const Kernels k = pickKernels();
+
+    cands.clear();
+    if (!out || anchors <= 0 || numClasses <= 0)
+        return;
+
+    if (featuresFirst) {
+        // Row f holds feature f of every anchor
+        const float *scores = out + 4 * anchors;
+        float best[kBlock];
+        for (int64_t a0 = 0; a0 < anchors; a0 += kBlock) {
+            const int n = int(std::min<int64_t>(kBlock, anchors - a0));
+            std::memcpy(best, scores + a0, sizeof(float) * n);
+            for (int c = 1; c < numClasses; ++c)
+                k.rowMax(best, scores + c * anchors + a0, n);
+
+            for (int i = 0; i < n; ++i) {
+                if (!(best[i] >= confTh))
+                    continue;
+                const int64_t a = a0 + i;
+                int cls = 0;
+                while (cls < numClasses - 1 && scores[cls * anchors + a] != best[i])
+                    ++cls;
+                cands.push_back({out[a], out[anchors + a], out[2 * anchors + a], out[3 * anchors + a],
+                                 best[i], cls});
+            }
+        }
+        return;
+    }
+
+    // Row a holds all features of anchor a
+    const int64_t feat = 4 + numClasses;
+    for (int64_t a = 0; a < anchors; ++a) {
+        const float *row = out + a * feat;
+        const float score = k.maxOf(row + 4, numClasses);
+        if (!(score >= confTh))
+            continue;
+        int cls = 0;
+        while (cls < numClasses - 1 && row[4 + cls] != score)
+            ++cls;
+        cands.push_back({row[0], row[1], row[2], row[3], score, cls});
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef YOLO_DECODE_H
+#define YOLO_DECODE_H
+
+#include <cstdint>
+#include <vector>
+
+// One anchor that made the confidence threshold, still in model input pixels
+struct YoloCandidate {
+    float cx, cy, w, h;
+    float score;   // best class score
+    int   cls;     // its class, the first one on ties (like np.argmax)
+};
+
+// Picks the anchors of a YOLOv8-style output (F = 4 + numClasses features:
+// cx, cy, w, h, class scores) whose best class score is >= confTh. Handles
+// both layouts autolabel.py accepts: F x N (featuresFirst) and N x F.
+//
+// The best score is found first, with SIMD max over contiguous scores (the
+// class rows across a block of anchors for F x N, an anchor's scores for
+// N x F); only anchors that pass the threshold get an argmax and become
+// candidates, which is a handful out of the 8400.
+void decodeYoloOutput(const float *out, int64_t anchors, int numClasses, bool featuresFirst,
+                      float confTh, std::vector<YoloCandidate> &cands);
+
+#endif // YOLO_DECODE_H
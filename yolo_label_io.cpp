@@ -0,0 +1,168 @@
+#include "yolo_label_io.h"
+
+#include <QDebug>
+#include <QFile>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+static inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+#if !defined(__cpp_lib_to_chars) || __cpp_lib_to_chars < 201611L
+// Fallback for standard libraries without floating-point from_chars:
+// [-+]digits[.digits][e[-+]digits], which is all label files contain.
+static const char *parseDecimal(const char *p, const char *end, double &out)
+{
+    const char *start = p;
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+
+    double mant = 0;
+    int digits = 0, scale = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p, ++digits)
+        mant = mant * 10 + (*p - '0');
+    if (p < end && *p == '.') {
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p, ++digits, --scale)
+            mant = mant * 10 + (*p - '0');
+    }
+    if (digits == 0)
+        return start;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *e = p + 1;
+        bool eneg = false;
+        if (e < end && (*e == '-' || *e == '+')) eneg = (*e++ == '-');
+        if (e < end && *e >= '0' && *e <= '9') {
+            int ex = 0;
+            for (; e < end && *e >= '0' && *e <= '9'; ++e)
+                ex = std::min(ex * 10 + (*e - '0'), 9999);
+            scale += eneg ? -ex : ex;
+            p = e;
+        }
+    }
+    out = (neg ? -mant : mant) * std::pow(10.0, scale);
+    return p;
+}
+#endif
+
+static const char *parseNumber(const char *p, const char *end, double &out)
+{
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    if (p < end && *p == '+') ++p;   // from_chars rejects a leading '+'
+    const std::from_chars_result r = std::from_chars(p, end, out);
+    return r.ec == std::errc() ? r.ptr : p;
+#else
+    return parseDecimal(p, end, out);
+#endif
+}
+
+int parseYoloLabels(const char *data, qint64 size, QVector<YoloLabel> &out,
+                    QVector<YoloLabelError> *errors)
+{
+    const char *p = data;
+    const char *const end = data + size;
+    int added = 0;
+
+    for (int lineNo = 1; p < end; ++lineNo) {
+        const char *eol = static_cast<const char *>(memchr(p, '\n', size_t(end - p)));
+        if (!eol) eol = end;
+
+        // Up to 6 numbers, whitespace separated; like the old stream reader,
+        // anything after the 6th is ignored rather than dropping the box
+        double v[6];
+        int n = 0;
+        const char *reason = nullptr;
+        const char *q = p;
+        for (;;) {
+            while (q < eol && isBlank(*q)) ++q;
+            if (q == eol || n == 6)
+                break;
+            const char *next = parseNumber(q, eol, v[n]);
+            if (next == q || (next < eol && !isBlank(*next))) { reason = "not a number"; break; }
+            q = next;
+            ++n;
+        }
+
+        if (!reason && n != 0) {
+            if (n < 5)
+                reason = "expected 5 or 6 values";
+            else if (v[0] < 0 || v[0] != std::floor(v[0]) || v[0] > 1e6)
+                reason = "class id is not a non-negative integer";
+            else if (!std::isfinite(v[1]) || !std::isfinite(v[2]) || !std::isfinite(v[3]) || !std::isfinite(v[4]))
+                reason = "coordinate is not finite";
+        }
+
+        if (reason) {
+            if (errors) errors->push_back({lineNo, reason});
+        } else if (n != 0) {
+            YoloLabel l;
+            l.cls  = int(v[0]);
+            l.cx   = v[1];
+            l.cy   = v[2];
+            l.w    = v[3];
+            l.h    = v[4];
+            l.conf = n == 6 ? v[5] : 1.0;
+            out.push_back(l);
+            ++added;
+        }
+        p = eol + 1;
+    }
+    return added;
+}
+
+bool readYoloLabelFile(const QString &path, QVector<YoloLabel> &out,
+                       QVector<YoloLabelError> *errors)
+{
+    QFile f(path);
+    if (!f.exists())
+        return true;
+    if (!f.open(QIODevice::ReadOnly)) {
+        qWarning() << "[labels] cannot read" << path << ":" << f.errorString();
+        return false;
+    }
+
+    QVector<YoloLabelError> localErrors;
+    QVector<YoloLabelError> *errs = errors ? errors : &localErrors;
+    const int errorsBefore = errs->size();
+
+    const qint64 size = f.size();
+    if (size > 0) {
+        if (const uchar *mapped = f.map(0, size)) {
+            parseYoloLabels(reinterpret_cast<const char *>(mapped), size, out, errs);
+            f.unmap(const_cast<uchar *>(mapped));
+        } else {
+            const QByteArray data = f.readAll();   // not mappable (pipes, some network filesystems)
+            parseYoloLabels(data.constData(), data.size(), out, errs);
+        }
+    }
+
+    for (int i = errorsBefore; i < errs->size(); ++i)
+        qWarning().noquote() << QString("[labels] %1:%2: %3, line skipped")
+                                    .arg(path).arg(errs->at(i).line).arg(errs->at(i).reason);
+    return true;
+}
+
+QByteArray formatYoloLabels(const QVector<YoloLabel> &labels)
+{
+    const bool withConfidence = std::any_of(labels.begin(), labels.end(),
+                                            [](const YoloLabel &l) { return l.conf < 1.0; });
+    QByteArray out;
+    out.reserve(labels.size() * (withConfidence ? 48 : 40));
+    for (const YoloLabel &l : labels) {
+        out += QByteArray::number(l.cls);
+        for (double v : {l.cx, l.cy, l.w, l.h}) {
+            out += ' ';
+            out += QByteArray::number(v, 'f', 6);
+        }
+        if (withConfidence) {
+            out += ' ';
+            out += QByteArray::number(l.conf, 'f', 6);
+        }
+        out += '\n';
+    }
+    return out;
+}
@@ -0,0 +1,38 @@
+#ifndef YOLO_LABEL_IO_H
+#define YOLO_LABEL_IO_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+// One "cls cx cy w h [conf]" line of a YOLO label file, normalized coords.
+struct YoloLabel {
+    int    cls = 0;
+    double cx = 0, cy = 0, w = 0, h = 0;
+    double conf = 1.0;         // 1.0 when the file has no 6th column
+};
+
+struct YoloLabelError {
+    int         line = 0;      // 1-based
+    const char *reason = "";   // static string
+};
+
+// Parses label text in place: no per-line allocation, locale-independent
+// numbers. Columns after the 6th are ignored. Boxes are appended to `out`;
+// malformed lines are skipped and, if `errors` is given, reported there.
+// Returns the number of boxes appended.
+int parseYoloLabels(const char *data, qint64 size, QVector<YoloLabel> &out,
+                    QVector<YoloLabelError> *errors = nullptr);
+
+// Reads `path` in one go (memory-mapped when possible) and parses it. Returns
+// false only if the file exists but can't be read; a missing file is empty.
+// Malformed lines are logged with their line numbers.
+bool readYoloLabelFile(const QString &path, QVector<YoloLabel> &out,
+                       QVector<YoloLabelError> *errors = nullptr);
+
+// "cls cx cy w h" per line, 6 decimals, '.' whatever the locale. If any
+// box carries a model confidence (conf < 1) every line gets it as a 6th
+// column, so the file keeps one shape and the scores survive a reload.
+QByteArray formatYoloLabels(const QVector<YoloLabel> &labels);
+
+#endif // YOLO_LABEL_IO_H
@@ -0,0 +1,162 @@
+#include "yolo_nms.h"
+
+#include <algorithm>
+#include <numeric>
+
+// Runs shorter than this are checked against every kept box; a grid costs more
+static const int kBruteForce = 32;
+static const int kMaxCells   = 64;   // per side
+
+static float iouOf(const NmsBox &a, const NmsBox &b)
+{
+    const float w = std::max(0.0f, std::min(a.x2, b.x2) - std::max(a.x1, b.x1) + 1);
+    const float h = std::max(0.0f, std::min(a.y2, b.y2) - std::max(a.y1, b.y1) + 1);
+    const float inter = w * h;
+    const float areaA = (a.x2 - a.x1 + 1) * (a.y2 - a.y1 + 1);
+    const float areaB = (b.x2 - b.x1 + 1) * (b.y2 - b.y1 + 1);
+    return inter / (areaA + areaB - inter);
+}
+
+// Kept boxes of one run, bucketed by the cells they cover. A box can only
+// overlap boxes sharing one of its cells; with the inclusive areas above,
+// a box reaches one pixel past x2/y2.
+struct NmsGrid {
+    float x0 = 0, y0 = 0, inv = 1;
+    int   gx = 1, gy = 1;
+    std::vector<std::vector<int>> cells;
+    std::vector<int> touched;
+
+    void reset(const std::vector<NmsBox> &boxes, const int *run, int n)
+    {
+        for (int c : touched)
+            cells[c].clear();
+        touched.clear();
+
+        float x1 = boxes[run[0]].x1, y1 = boxes[run[0]].y1, x2 = x1, y2 = y1;
+        double sumSide = 0;
+        for (int k = 0; k < n; ++k) {
+            const NmsBox &b = boxes[run[k]];
+            x1 = std::min(x1, b.x1);
+            y1 = std::min(y1, b.y1);
+            x2 = std::max(x2, b.x2 + 1);
+            y2 = std::max(y2, b.y2 + 1);
+            sumSide += std::max(b.x2 - b.x1, b.y2 - b.y1) + 1;
+        }
+        // About one average box per cell, but no finer than kMaxCells a side
+        const float extent = std::max(x2 - x1, y2 - y1);
+        const float cell = std::max({float(sumSide / n), extent / kMaxCells, 1.0f});
+        x0  = x1;
+        y0  = y1;
+        inv = 1.0f / cell;
+        gx  = std::clamp(int((x2 - x1) * inv) + 1, 1, kMaxCells);
+        gy  = std::clamp(int((y2 - y1) * inv) + 1, 1, kMaxCells);
+        if (int(cells.size()) < gx * gy)
+            cells.resize(gx * gy);
+    }
+
+    void span(const NmsBox &b, int &cx0, int &cy0, int &cx1, int &cy1) const
+    {
+        cx0 = std::clamp(int((b.x1 - x0) * inv), 0, gx - 1);
+        cy0 = std::clamp(int((b.y1 - y0) * inv), 0, gy - 1);
+        cx1 = std::clamp(int((b.x2 + 1 - x0) * inv), 0, gx - 1);
+        cy1 = std::clamp(int((b.y2 + 1 - y0) * inv), 0, gy - 1);
+    }
+};
+
+static void suppressRun(const std::vector<NmsBox> &boxes, const int *run, int n, float iouTh,
+                        NmsGrid &grid, std::vector<int> &checkedBy, int &stamp, std::vector<int> &keep)
+{
+    const size_t first = keep.size();
+    if (n < kBruteForce) {
+        for (int k = 0; k < n; ++k) {
+            const NmsBox &b = boxes[run[k]];
+            bool suppressed = false;
+            for (size_t j = first; j < keep.size() && !suppressed; ++j)
+                suppressed = iouOf(boxes[keep[j]], b) > iouTh;
+            if (!suppressed)
+                keep.push_back(run[k]);
+        }
+        return;
+    }
+
+    grid.reset(boxes, run, n);
+    for (int k = 0; k < n; ++k) {
+        const NmsBox &b = boxes[run[k]];
+        int cx0, cy0, cx1, cy1;
+        grid.span(b, cx0, cy0, cx1, cy1);
+
+        // A kept box spanning several of these cells is tested once
+        ++stamp;
+        bool suppressed = false;
+        for (int cy = cy0; cy <= cy1 && !suppressed; ++cy) {
+            for (int cx = cx0; cx <= cx1 && !suppressed; ++cx) {
+                for (int j : grid.cells[cy * grid.gx + cx]) {
+                    if (checkedBy[j] == stamp)
+                        continue;
+                    checkedBy[j] = stamp;
+                    if (iouOf(boxes[j], b) > iouTh) {
+                        suppressed = true;
+                        break;
+                    }
+                }
+            }
+        }
+        if (suppressed)
+            continue;
+
+        keep.push_back(run[k]);
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            for (int cx = cx0; cx <= cx1; ++cx) {
+                std::vector<int> &cell = grid.cells[cy * grid.gx + cx];
+                if (cell.empty())
+                    grid.touched.push_back(cy * grid.gx + cx);
+                cell.push_back(run[k]);
+            }
+        }
+    }
+}
+
+std::vector<int> yoloNms(const std::vector<NmsBox> &boxes, float iouTh, bool classAgnostic)
+{
+    std::vector<int> keep;
+    const int n = int(boxes.size());
+    if (n == 0)
+        return keep;
+
+    // The one sort: by score, ties in input order
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return boxes[a].score > boxes[b].score; });
+
+    // Per class: a stable counting pass groups the classes, ascending, each
+    // run still in score order
+    std::vector<int> runStart{0, n};
+    if (!classAgnostic) {
+        const auto mm = std::minmax_element(boxes.begin(), boxes.end(),
+                                            [](const NmsBox &a, const NmsBox &b) { return a.cls < b.cls; });
+        const int lo = mm.first->cls, span = mm.second->cls - lo + 1;
+        std::vector<int> offset(span + 1, 0);
+        for (const NmsBox &b : boxes)
+            ++offset[b.cls - lo + 1];
+        std::partial_sum(offset.begin(), offset.end(), offset.begin());
+
+        runStart.clear();
+        for (int c = 0; c < span; ++c)
+            if (offset[c + 1] > offset[c])
+                runStart.push_back(offset[c]);
+        runStart.push_back(n);
+
+        std::vector<int> grouped(n);
+        for (int i : order)
+            grouped[offset[boxes[i].cls - lo]++] = i;
+        order.swap(grouped);
+    }
+
+    NmsGrid grid;
+    std::vector<int> checkedBy(n, 0);
+    int stamp = 0;
+    for (size_t r = 0; r + 1 < runStart.size(); ++r)
+        suppressRun(boxes, order.data() + runStart[r], runStart[r + 1] - runStart[r], iouTh,
+                    grid, checkedBy, stamp, keep);
+    return keep;
+}
@@ -0,0 +1,29 @@
+#ifndef YOLO_NMS_H
+#define YOLO_NMS_H
+
+#include <vector>
+
+// A candidate box in image pixels, corners inclusive
+struct NmsBox {
+    float x1, y1, x2, y2;
+    float score;
+    int   cls;
+};
+
+// Greedy non-maximum suppression with the overlap rule of nms() in
+// models/autolabel.py: pixel-inclusive areas, a box is dropped when its IoU
+// with a kept, higher-scoring box is > iouTh. Per-class (the default) only
+// lets boxes of the same class suppress each other; classAgnostic lets any
+// box suppress any other.
+//
+// Returns the indices of the kept boxes: per class, classes ascending and
+// by score within each (the order autolabel.py writes them in); agnostic,
+// by score. Equal scores keep their input order.
+//
+// The candidates are sorted by score once, then split into per-class runs
+// that stay in score order. Within a run each box is only tested against
+// the kept boxes in the grid cells it covers, not against every kept box,
+// which keeps crowded frames with thousands of candidates near linear.
+std::vector<int> yoloNms(const std::vector<NmsBox> &boxes, float iouTh, bool classAgnostic = false);
+
+#endif // YOLO_NMS_H
@@ -0,0 +1,216 @@
+#include "yolo_onnx.h"
+#include "yolo_decode.h"
+#include "yolo_nms.h"
+#include "yolo_preprocess.h"
+
+#include <onnxruntime_cxx_api.h>
+
+#include <QDebug>
+#include <QFile>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+
+// Mirrors models/autolabel.py so the in-process backend and the script produce
+// the same labels: letterbox (pad 114) -> RGB CHW /255 (letterboxChw) ->
+// argmax/threshold -> undo letterbox -> per-class NMS.
+
+// Input tensors (and their float buffers) are made once and reused; one per
+// infer() call running at the same time.
+struct InputTensor {
+    std::vector<float> data;
+    Ort::Value value{nullptr};
+};
+
+struct InputPool {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<InputTensor>> free;
+};
+
+YoloOnnx::YoloOnnx(const QString& onnxPath, int inputW, int inputH, float confTh, float iouTh)
+    : inW_(inputW), inH_(inputH), conf_(confTh), iou_(iouTh), path_(onnxPath)
+{
+    inputs_ = new InputPool;
+    try {
+        auto *env = new Ort::Env(ORT_LOGGING_LEVEL_WARNING, "YoloLabel");
+        env_ = env;
+
+        Ort::SessionOptions opts;
+        opts.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+
+#ifdef _WIN32
+        const std::wstring modelPath = onnxPath.toStdWString();
+#else
+        const std::string modelPath = QFile::encodeName(onnxPath).toStdString();
+#endif
+        auto *session = new Ort::Session(*env, modelPath.c_str(), opts);
+        session_ = session;
+
+        Ort::AllocatorWithDefaultOptions alloc;
+        inName_  = session->GetInputNameAllocated(0, alloc).get();
+        outName_ = session->GetOutputNameAllocated(0, alloc).get();
+
+        // Honour a fixed input size baked into the model (dynamic dims are <= 0)
+        auto inShape = session->GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+        if (inShape.size() == 4) {
+            if (inShape[2] > 0) inH_ = int(inShape[2]);
+            if (inShape[3] > 0) inW_ = int(inShape[3]);
+        }
+    } catch (const Ort::Exception &e) {
+        error_ = QString::fromUtf8(e.what());
+        qWarning() << "[onnx] failed to load" << onnxPath << ":" << error_;
+        delete static_cast<Ort::Session *>(session_);
+        session_ = nullptr;
+    }
+}
+
+YoloOnnx::~YoloOnnx()
+{
+    delete static_cast<Ort::Session *>(session_);
+    delete static_cast<Ort::Env *>(env_);
+    delete static_cast<InputPool *>(inputs_);
+}
+
+bool YoloOnnx::isReady() const
+{
+    return session_ != nullptr;
+}
+
+std::vector<YoloDet> YoloOnnx::infer(const QImage& imgRGBAorRGB)
+{
+    std::vector<YoloDet> result;
+    if (!isReady() || imgRGBAorRGB.isNull())
+        return result;
+
+    const int W = imgRGBAorRGB.width();
+    const int H = imgRGBAorRGB.height();
+
+    // Borrow an input tensor; handed back however this returns
+    InputPool &pool = *static_cast<InputPool *>(inputs_);
+    std::unique_ptr<InputTensor> input;
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        if (!pool.free.empty()) {
+            input = std::move(pool.free.back());
+            pool.free.pop_back();
+        }
+    }
+    struct GiveBack {
+        InputPool &pool;
+        std::unique_ptr<InputTensor> &input;
+        ~GiveBack() {
+            if (!input)
+                return;
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            pool.free.push_back(std::move(input));
+        }
+    } giveBack{pool, input};
+
+    // --- letterbox, RGB CHW / 255, in one pass ---
+    try {
+        if (!input) {
+            input = std::make_unique<InputTensor>();
+            input->data.resize(size_t(inW_) * inH_ * 3);
+            const int64_t shape[4] = {1, 3, inH_, inW_};
+            Ort::MemoryInfo mem = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+            input->value = Ort::Value::CreateTensor<float>(mem, input->data.data(), input->data.size(), shape, 4);
+        }
+    } catch (const Ort::Exception &e) {
+        qWarning() << "[onnx] cannot create the input tensor:" << e.what();
+        return result;
+    }
+    const Letterbox lb = letterboxChw(imgRGBAorRGB, inW_, inH_, input->data.data());
+    const double r = lb.scale;
+    const int left = lb.left;
+    const int top  = lb.top;
+
+    // --- infer ---
+    std::vector<Ort::Value> outputs;
+    try {
+        auto *session = static_cast<Ort::Session *>(session_);
+        const char *inNames[]  = {inName_.c_str()};
+        const char *outNames[] = {outName_.c_str()};
+        outputs = session->Run(Ort::RunOptions{nullptr}, inNames, &input->value, 1, outNames, 1);
+    } catch (const Ort::Exception &e) {
+        // Not kept in error_: infer() may be running on other threads too
+        qWarning() << "[onnx] inference failed:" << e.what();
+        return result;
+    }
+
+    // --- decode: (1, F, N) or (1, N, F) or (N, F) with F = 4 + classes ---
+    const std::vector<int64_t> oshape = outputs[0].GetTensorTypeAndShapeInfo().GetShape();
+    if (oshape.size() < 2)
+        return result;
+    const int64_t d0 = oshape[oshape.size() - 2];
+    const int64_t d1 = oshape[oshape.size() - 1];
+
+    // One read per call: the GUI thread may change these while we run
+    const int  numClasses = numClasses_.load(std::memory_order_relaxed);
+    const bool agnostic   = agnosticNms_.load(std::memory_order_relaxed);
+
+    bool featuresFirst;
+    int64_t feat;
+    if (numClasses > 0 && d0 == 4 + numClasses)      { featuresFirst = true;  feat = d0; }
+    else if (numClasses > 0 && d1 == 4 + numClasses) { featuresFirst = false; feat = d1; }
+    else if (numClasses > 0) {
+        qWarning() << "[onnx] unexpected output shape" << d0 << "x" << d1
+                   << "for" << numClasses << "classes";
+        return result;
+    } else {
+        featuresFirst = d0 < d1;
+        feat = featuresFirst ? d0 : d1;
+    }
+    const int64_t anchors = featuresFirst ? d1 : d0;
+    const int nc = int(feat - 4);
+    if (nc <= 0)
+        return result;
+
+    const float *out = outputs[0].GetTensorData<float>();
+    std::vector<YoloCandidate> raw;
+    decodeYoloOutput(out, anchors, nc, featuresFirst, conf_, raw);
+
+    std::vector<NmsBox> cands;
+    cands.reserve(raw.size());
+    for (const YoloCandidate &rc : raw) {
+        NmsBox cd;
+        cd.x1 = std::clamp(float((rc.cx - rc.w / 2 - left) / r), 0.0f, float(W - 1));
+        cd.y1 = std::clamp(float((rc.cy - rc.h / 2 - top)  / r), 0.0f, float(H - 1));
+        cd.x2 = std::clamp(float((rc.cx + rc.w / 2 - left) / r), 0.0f, float(W - 1));
+        cd.y2 = std::clamp(float((rc.cy + rc.h / 2 - top)  / r), 0.0f, float(H - 1));
+        cd.score = rc.score;
+        cd.cls = rc.cls;
+        cands.push_back(cd);
+    }
+
+    // --- NMS; per class, classes in ascending order like np.unique ---
+    for (int k : yoloNms(cands, iou_, agnostic)) {
+        const NmsBox &cd = cands[k];
+        YoloDet d;
+        d.cls  = cd.cls;
+        d.conf = cd.score;
+        d.x    = cd.x1 / W;
+        d.y    = cd.y1 / H;
+        d.w    = (cd.x2 - cd.x1) / W;
+        d.h    = (cd.y2 - cd.y1) / H;
+        result.push_back(d);
+    }
+    return result;
+}
+
+QVector<YoloLabel> detectionsToLabels(const std::vector<YoloDet> &dets)
+{
+    QVector<YoloLabel> labels;
+    labels.reserve(int(dets.size()));
+    for (const YoloDet &d : dets) {
+        YoloLabel l;
+        l.cls  = d.cls;
+        l.cx   = d.x + d.w / 2.;
+        l.cy   = d.y + d.h / 2.;
+        l.w    = d.w;
+        l.h    = d.h;
+        l.conf = d.conf;
+        labels.push_back(l);
+    }
+    return labels;
+}
@@ -1,8 +1,13 @@
 #pragma once
 #include <QString>
 #include <QImage>
+#include <QVector>
 #include <vector>
 #include <utility>
+#include <string>
+#include <atomic>
+
+#include "yolo_label_io.h"
 
 struct YoloDet {
     int cls;
@@ -14,12 +19,40 @@ struct YoloDet {
 class YoloOnnx {
 public:
     YoloOnnx(const QString& onnxPath, int inputW=640, int inputH=640, float confTh=0.25f, float iouTh=0.45f);
+    ~YoloOnnx();
+    YoloOnnx(const YoloOnnx&) = delete;
+    YoloOnnx& operator=(const YoloOnnx&) = delete;
+
     bool isReady() const;
+    QString errorString() const { return error_; }
+    QString modelPath() const { return path_; }
+
+    // Number of classes in the names file; used to tell the feature axis of
+    // the output apart from the anchor axis (<= 0: guess from the shape).
+    // Like the setter below, safe while infer() runs; a call already in
+    // flight finishes with the old value.
+    void setNumClasses(int n) { numClasses_.store(n, std::memory_order_relaxed); }
+    int  numClasses() const { return numClasses_.load(std::memory_order_relaxed); }
+
+    // Let boxes of different classes suppress each other (autolabel.py doesn't)
+    void setClassAgnosticNms(bool on) { agnosticNms_.store(on, std::memory_order_relaxed); }
+    bool classAgnosticNms() const { return agnosticNms_.load(std::memory_order_relaxed); }
+
+    // Safe to call from several threads at once (Ort::Session::Run is)
     std::vector<YoloDet> infer(const QImage& imgRGBAorRGB);
 
 private:
     void* session_=nullptr; // ORT session opaque ptr
     void* env_=nullptr;     // ORT env
+    void* inputs_=nullptr;  // reused input tensors (InputPool)
     int inW_, inH_;
     float conf_, iou_;
+    std::atomic<int>  numClasses_{-1};
+    std::atomic<bool> agnosticNms_{false};
+    QString path_;
+    QString error_;
+    std::string inName_, outName_;
 };
+
+// Detections in label-file form, confidences included
+QVector<YoloLabel> detectionsToLabels(const std::vector<YoloDet> &dets);
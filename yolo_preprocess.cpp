@@ -0,0 +1,290 @@
+#include "yolo_preprocess.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PRE_X86_DISPATCH 1
+#elif (defined(__aarch64__) || defined(_M_ARM64)) && !defined(__AARCH64EB__)
+#include <arm_neon.h>
+#define PRE_NEON 1
+#endif
+
+static const float kPad = 114.0f / 255.0f;
+
+// dst = a * wa + b * wb; the weights carry the / 255
+typedef void (*BlendKernel)(const float *a, const float *b, float wa, float wb, float *dst, int n);
+
+// Horizontal resample of one packed RGB row into three planar rows:
+// out[x] = s[x0[x] + c] + (s[x1[x] + c] - s[x0[x] + c]) * w[x], offsets in
+// bytes. The SIMD kernels load 4 bytes per tap (the pixel and one past it),
+// so every offset they get must leave 4 readable bytes.
+typedef void (*HorizKernel)(const uchar *s, const int *x0, const int *x1, const float *w,
+                            float *r, float *g, float *b, int n);
+
+static void blendScalar(const float *a, const float *b, float wa, float wb, float *dst, int n)
+{
+    for (int i = 0; i < n; ++i)
+        dst[i] = a[i] * wa + b[i] * wb;
+}
+
+static void horizScalar(const uchar *s, const int *x0, const int *x1, const float *w,
+                        float *r, float *g, float *b, int n)
+{
+    for (int x = 0; x < n; ++x) {
+        const uchar *p = s + x0[x], *q = s + x1[x];
+        const float a = w[x];
+        r[x] = p[0] + (q[0] - p[0]) * a;
+        g[x] = p[1] + (q[1] - p[1]) * a;
+        b[x] = p[2] + (q[2] - p[2]) * a;
+    }
+}
+
+// One pixel's bytes as a little-endian word: R in bits 0-7, G 8-15, B 16-23
+static inline quint32 loadPixel(const uchar *p)
+{
+    quint32 v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+#if PRE_X86_DISPATCH
+__attribute__((target("sse2")))
+static void blendSse2(const float *a, const float *b, float wa, float wb, float *dst, int n)
+{
+    const __m128 va = _mm_set1_ps(wa);
+    const __m128 vb = _mm_set1_ps(wb);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + i), va),
+                                          _mm_mul_ps(_mm_loadu_ps(b + i), vb)));
+    blendScalar(a + i, b + i, wa, wb, dst + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void horizSse2(const uchar *s, const int *x0, const int *x1, const float *w,
+                      float *r, float *g, float *b, int n)
+{
+    const __m128i low = _mm_set1_epi32(0xff);
+    int x = 0;
+    for (; x + 4 <= n; x += 4) {
+        const __m128i p = _mm_setr_epi32(int(loadPixel(s + x0[x])),     int(loadPixel(s + x0[x + 1])),
+                                         int(loadPixel(s + x0[x + 2])), int(loadPixel(s + x0[x + 3])));
+        const __m128i q = _mm_setr_epi32(int(loadPixel(s + x1[x])),     int(loadPixel(s + x1[x + 1])),
+                                         int(loadPixel(s + x1[x + 2])), int(loadPixel(s + x1[x + 3])));
+        const __m128 a = _mm_loadu_ps(w + x);
+
+        const __m128 pr = _mm_cvtepi32_ps(_mm_and_si128(p, low));
+        const __m128 qr = _mm_cvtepi32_ps(_mm_and_si128(q, low));
+        const __m128 pg = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 8), low));
+        const __m128 qg = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(q, 8), low));
+        const __m128 pb = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 16), low));
+        const __m128 qb = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(q, 16), low));
+        _mm_storeu_ps(r + x, _mm_add_ps(pr, _mm_mul_ps(_mm_sub_ps(qr, pr), a)));
+        _mm_storeu_ps(g + x, _mm_add_ps(pg, _mm_mul_ps(_mm_sub_ps(qg, pg), a)));
+        _mm_storeu_ps(b + x, _mm_add_ps(pb, _mm_mul_ps(_mm_sub_ps(qb, pb), a)));
+    }
+    horizScalar(s, x0 + x, x1 + x, w + x, r + x, g + x, b + x, n - x);
+}
+
+__attribute__((target("avx2,fma")))
+static void blendAvx2(const float *a, const float *b, float wa, float wb, float *dst, int n)
+{
+    const __m256 va = _mm256_set1_ps(wa);
+    const __m256 vb = _mm256_set1_ps(wb);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_fmadd_ps(_mm256_loadu_ps(a + i), va,
+                                                  _mm256_mul_ps(_mm256_loadu_ps(b + i), vb)));
+    blendScalar(a + i, b + i, wa, wb, dst + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+static void horizAvx2(const uchar *s, const int *x0, const int *x1, const float *w,
+                      float *r, float *g, float *b, int n)
+{
+    const __m256i low = _mm256_set1_epi32(0xff);
+    const int *base = reinterpret_cast<const int *>(s);
+    int x = 0;
+    for (; x + 8 <= n; x += 8) {
+        const __m256i p = _mm256_i32gather_epi32(base, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(x0 + x)), 1);
+        const __m256i q = _mm256_i32gather_epi32(base, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(x1 + x)), 1);
+        const __m256 a = _mm256_loadu_ps(w + x);
+
+        const __m256 pr = _mm256_cvtepi32_ps(_mm256_and_si256(p, low));
+        const __m256 qr = _mm256_cvtepi32_ps(_mm256_and_si256(q, low));
+        const __m256 pg = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(p, 8), low));
+        const __m256 qg = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(q, 8), low));
+        const __m256 pb = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(p, 16), low));
+        const __m256 qb = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(q, 16), low));
+        _mm256_storeu_ps(r + x, _mm256_fmadd_ps(_mm256_sub_ps(qr, pr), a, pr));
+        _mm256_storeu_ps(g + x, _mm256_fmadd_ps(_mm256_sub_ps(qg, pg), a, pg));
+        _mm256_storeu_ps(b + x, _mm256_fmadd_ps(_mm256_sub_ps(qb, pb), a, pb));
+    }
+    horizScalar(s, x0 + x, x1 + x, w + x, r + x, g + x, b + x, n - x);
+}
+#endif
+
+#if PRE_NEON
+static void blendNeon(const float *a, const float *b, float wa, float wb, float *dst, int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+        vst1q_f32(dst + i, vfmaq_n_f32(vmulq_n_f32(vld1q_f32(b + i), wb), vld1q_f32(a + i), wa));
+    blendScalar(a + i, b + i, wa, wb, dst + i, n - i);
+}
+
+static void horizNeon(const uchar *s, const int *x0, const int *x1, const float *w,
+                      float *r, float *g, float *b, int n)
+{
+    const uint32x4_t low = vdupq_n_u32(0xff);
+    int x = 0;
+    for (; x + 4 <= n; x += 4) {
+        const quint32 pw[4] = {loadPixel(s + x0[x]), loadPixel(s + x0[x + 1]),
+                               loadPixel(s + x0[x + 2]), loadPixel(s + x0[x + 3])};
+        const quint32 qw[4] = {loadPixel(s + x1[x]), loadPixel(s + x1[x + 1]),
+                               loadPixel(s + x1[x + 2]), loadPixel(s + x1[x + 3])};
+        const uint32x4_t p = vld1q_u32(pw), q = vld1q_u32(qw);
+        const float32x4_t a = vld1q_f32(w + x);
+
+        const float32x4_t pr = vcvtq_f32_u32(vandq_u32(p, low));
+        const float32x4_t qr = vcvtq_f32_u32(vandq_u32(q, low));
+        const float32x4_t pg = vcvtq_f32_u32(vandq_u32(vshrq_n_u32(p, 8), low));
+        const float32x4_t qg = vcvtq_f32_u32(vandq_u32(vshrq_n_u32(q, 8), low));
+        const float32x4_t pb = vcvtq_f32_u32(vandq_u32(vshrq_n_u32(p, 16), low));
+        const float32x4_t qb = vcvtq_f32_u32(vandq_u32(vshrq_n_u32(q, 16), low));
+        vst1q_f32(r + x, vfmaq_f32(pr, vsubq_f32(qr, pr), a));
+        vst1q_f32(g + x, vfmaq_f32(pg, vsubq_f32(qg, pg), a));
+        vst1q_f32(b + x, vfmaq_f32(pb, vsubq_f32(qb, pb), a));
+    }
+    horizScalar(s, x0 + x, x1 + x, w + x, r + x, g + x, b + x, n - x);
+}
+#endif
+
+struct Kernels {
+    BlendKernel blend;
+    HorizKernel horiz;
+};
+
+static Kernels pickKernels()
+{
+#if PRE_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return {blendAvx2, horizAvx2};
+    if (__builtin_cpu_supports("sse2"))
+        return {blendSse2, horizSse2};
+    return {blendScalar, horizScalar};
+#elif PRE_NEON
+    return {blendNeon, horizNeon};
+#else
+    return {blendScalar, horizScalar};
+#endif
+}
+
+// cv2 INTER_LINEAR sampling: pixel centres line up, edges clamp
+static void linearTaps(int src, int dst, std::vector<int> &i0, std::vector<int> &i1, std::vector<float> &w)
+{
+    i0.resize(dst);
+    i1.resize(dst);
+    w.resize(dst);
+    const double scale = double(src) / dst;
+    for (int x = 0; x < dst; ++x) {
+        const double f = std::max(0.0, (x + 0.5) * scale - 0.5);
+        int k = int(f);
+        float a = float(f - k);
+        if (k >= src - 1) {
+            k = src - 1;
+            a = 0.0f;
+        }
+        i0[x] = k;
+        i1[x] = std::min(k + 1, src - 1);
+        w[x]  = a;
+    }
+}
+
+Letterbox letterboxChw(const uchar *rgb, int width, int height, qsizetype bytesPerLine,
+                       int inW, int inH, float *dst)
+{
+    static const Kernels k = pickKernels();
+
+    Letterbox lb;
+    const size_t plane = size_t(inW) * inH;
+    if (!rgb || width <= 0 || height <= 0) {
+        std::fill(dst, dst + plane * 3, kPad);
+        return lb;
+    }
+
+    lb.scale  = std::min(inW / double(width), inH / double(height));
+    lb.width  = std::clamp(int(std::round(width * lb.scale)), 1, inW);
+    lb.height = std::clamp(int(std::round(height * lb.scale)), 1, inH);
+    lb.left   = (inW - lb.width) / 2;
+    lb.top    = (inH - lb.height) / 2;
+    const int nw = lb.width, nh = lb.height;
+
+    std::vector<int> x0, x1, y0, y1;
+    std::vector<float> wx, wy;
+    linearTaps(width, nw, x0, x1, wx);
+    linearTaps(height, nh, y0, y1, wy);
+    for (int &x : x0) x *= 3;
+    for (int &x : x1) x *= 3;
+
+    // The taps ascend with x; from the first one on the last source pixel
+    // on, a 4-byte load would run past the row, so those stay scalar
+    const int lastPixel = (width - 1) * 3;
+    const int nSimd = int(std::lower_bound(x1.begin(), x1.end(), lastPixel) - x1.begin());
+
+    // Two horizontally resampled source rows, each as three planar rows
+    std::vector<float> rows(size_t(nw) * 6);
+    float *slot[2] = {rows.data(), rows.data() + size_t(nw) * 3};
+    int slotRow[2] = {-1, -1};
+
+    auto resampleRow = [&](int sy) -> const float * {
+        // slot[1] is the most recently used; a miss overwrites the other one
+        if (slotRow[1] == sy)
+            return slot[1];
+        std::swap(slot[0], slot[1]);
+        std::swap(slotRow[0], slotRow[1]);
+        if (slotRow[1] == sy)
+            return slot[1];
+        slotRow[1] = sy;
+        float *r = slot[1], *g = r + nw, *b = g + nw;
+        const uchar *s = rgb + qsizetype(sy) * bytesPerLine;
+        k.horiz(s, x0.data(), x1.data(), wx.data(), r, g, b, nSimd);
+        horizScalar(s, x0.data() + nSimd, x1.data() + nSimd, wx.data() + nSimd,
+                    r + nSimd, g + nSimd, b + nSimd, nw - nSimd);
+        return r;
+    };
+
+    for (int c = 0; c < 3; ++c) {
+        float *pl = dst + plane * c;
+        std::fill(pl, pl + size_t(lb.top) * inW, kPad);
+        std::fill(pl + size_t(lb.top + nh) * inW, pl + plane, kPad);
+    }
+
+    const int right = inW - lb.left - nw;
+    for (int y = 0; y < nh; ++y) {
+        const float *a = resampleRow(y0[y]);
+        const float *b = resampleRow(y1[y]);
+        const float fy = wy[y];
+        const size_t row = size_t(lb.top + y) * inW;
+        for (int c = 0; c < 3; ++c) {
+            float *out = dst + plane * c + row;
+            std::fill(out, out + lb.left, kPad);
+            k.blend(a + size_t(nw) * c, b + size_t(nw) * c, (1.0f - fy) / 255.0f, fy / 255.0f, out + lb.left, nw);
+            std::fill(out + lb.left + nw, out + lb.left + nw + right, kPad);
+        }
+    }
+    return lb;
+}
+
+Letterbox letterboxChw(const QImage &image, int inW, int inH, float *dst)
+{
+    if (image.format() == QImage::Format_RGB888)
+        return letterboxChw(image.constBits(), image.width(), image.height(), image.bytesPerLine(), inW, inH, dst);
+    const QImage rgb = image.convertToFormat(QImage::Format_RGB888);
+    return letterboxChw(rgb.constBits(), rgb.width(), rgb.height(), rgb.bytesPerLine(), inW, inH, dst);
+}
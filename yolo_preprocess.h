@@ -0,0 +1,31 @@
+#ifndef YOLO_PREPROCESS_H
+#define YOLO_PREPROCESS_H
+
+#include <QImage>
+
+// Where the image landed inside the model input
+struct Letterbox {
+    double scale = 1.0;   // input pixels per image pixel
+    int    left = 0;      // padding before the image, input pixels
+    int    top = 0;
+    int    width = 0;     // size of the resized image
+    int    height = 0;
+};
+
+// YOLO input preprocessing in one pass, the same steps as letterbox() and
+// the lines after it in models/autolabel.py: bilinear resize (cv2
+// INTER_LINEAR sampling) to fit inW x inH, pad with 114, RGB planes
+// (CHW), values / 255. `dst` holds 3 * inW * inH floats and is written in
+// full, so it can be reused between images without clearing.
+//
+// Each image row is resampled horizontally once, straight into three
+// planar float rows: each tap loads a whole RGB pixel and widens its bytes
+// to floats in vector registers (AVX2 gathers, SSE2 or NEON). The vertical
+// blend and the /255 are then one multiply-add per value, vectorised too.
+Letterbox letterboxChw(const QImage &image, int inW, int inH, float *dst);
+
+// The same on packed 8-bit RGB rows
+Letterbox letterboxChw(const uchar *rgb, int width, int height, qsizetype bytesPerLine,
+                       int inW, int inH, float *dst);
+
+#endif // YOLO_PREPROCESS_H